@@ -0,0 +1,331 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "husb238.h"
+#include "husb238_conn.h"
+#include "host_pico.h"
+
+// Fuzz-Ziel für die Register-Dekodierung und die Verbindungs-Zustandsmaschine.
+// Die Eingabe wird als Folge von Bus-Transaktionen ausgeliefert: jede Transaktion
+// verbraucht ein Steuerbyte (Busfehler ja/nein), ein Lesezugriff zusätzlich ein
+// Byte pro Register. Ist die Eingabe aufgebraucht, schlägt jeder Zugriff fehl.
+// Nach jedem Poll werden alle Status-Getter aufgerufen und gegen eine eigene
+// Dekodierung des ausgelieferten Registerwerts geprüft.
+
+#define MAX_POLLS				256		///< Polls per input
+#define MAX_TRANSACTIONS_POLL	8		///< Bus transactions one poll may need
+#define DEBOUNCE_US				20000	///< Debounce time of the state machine
+
+#define CHECK(cond) do { if(!(cond)) { fprintf(stderr, "invariant violated %s:%d: %s\n", __FILE__, __LINE__, #cond); abort(); } } while(0)
+
+static const uint8_t *input = NULL;	///< Fuzz input being served
+static size_t input_len = 0;		///< Length of the fuzz input
+static size_t input_pos = 0;		///< Next byte to serve
+
+static uint8_t last_value = 0;		///< Register value served by the last single register read, 0 on a fault
+static uint8_t pdo_image[MAX_PROFILES];	///< PDO registers served by the last burst read of all PDOs
+static bool pdo_image_ok = false;		///< The last burst read of all PDOs succeeded
+
+static uint32_t transactions = 0;	///< Bus transactions since the last reset
+static uint32_t pdo_reads = 0;		///< Burst reads of the PDO registers since the last reset
+static uint32_t requests = 0;		///< PD requests since the last reset
+
+/**************************************************************************/
+/**
+ * @brief Returns the next byte of the fuzz input, `false` once the input is used up.
+ */
+/**************************************************************************/
+static bool next_byte(uint8_t *value)
+{
+	if(input_pos >= input_len)
+	{
+		return false;
+	}
+	*value = input[input_pos++];
+	return true;
+}
+
+/**************************************************************************/
+/**
+ * @brief Transport `write` function: the control byte decides about a bus fault.
+ */
+/**************************************************************************/
+static bool fuzz_write(uint8_t reg, uint8_t value, void *ctx)
+{
+	uint8_t ctrl;
+	transactions++;
+	CHECK(reg <= HUSB238_GO_COMMAND);
+	if(reg == HUSB238_GO_COMMAND && value == 0b00001)
+	{
+		requests++;
+	}
+	return next_byte(&ctrl) && (ctrl & 0x07) != 0;
+}
+
+/**************************************************************************/
+/**
+ * @brief Transport `read` function: serves the next `len` bytes as register images.
+ */
+/**************************************************************************/
+static bool fuzz_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx)
+{
+	uint8_t ctrl;
+	transactions++;
+	CHECK(len > 0 && reg + len <= HUSB238_GO_COMMAND + 1);
+	bool pdo = reg == HUSB238_SRC_PDO_5V && len == MAX_PROFILES;
+	if(reg == HUSB238_SRC_PDO_5V)
+	{
+		pdo_reads++;
+	}
+	last_value = 0;
+	if(pdo)
+	{
+		pdo_image_ok = false;
+	}
+	if(!next_byte(&ctrl) || (ctrl & 0x07) == 0)
+	{
+		return false;
+	}
+	for(uint8_t i = 0; i < len; i++)
+	{
+		if(!next_byte(&value[i]))
+		{
+			return false;
+		}
+	}
+	last_value = value[0];
+	if(pdo)
+	{
+		memcpy(pdo_image, value, MAX_PROFILES);
+		pdo_image_ok = true;
+	}
+	return true;
+}
+
+static const HUSB238Transport fuzz_transport = {fuzz_write, fuzz_read, NULL};	///< Serves the fuzz input
+
+// Unabhängige Dekodierung nach Datenblatt, nicht über die Funktionen des Treibers
+static const uint16_t current_ma[16] = {
+	500, 700, 1000, 1250, 1500, 1750, 2000, 2250, 2500, 2750, 3000, 3250, 3500, 4000, 4500, 5000
+};
+static const uint8_t pdo_src[MAX_PROFILES] = {
+	PD_SRC_5V, PD_SRC_9V, PD_SRC_12V, PD_SRC_15V, PD_SRC_18V, PD_SRC_20V
+};
+static const uint8_t pdo_volts[MAX_PROFILES] = {5, 9, 12, 15, 18, 20};
+
+/// PD_SRC_* value of the voltage code in bits 4-7 of PD_STATUS0
+static uint8_t status0_src(uint8_t status0)
+{
+	uint8_t code = status0 >> 4;
+	return (code >= 1 && code <= MAX_PROFILES) ? pdo_src[code - 1] : PD_NOT_SELECTED;
+}
+
+/**************************************************************************/
+/**
+ * @brief Checks `supported_profiles` against the PDO registers served by the last
+ * enumeration, or checks that it is empty.
+ */
+/**************************************************************************/
+static void check_profiles(uint8_t cnt, bool from_image)
+{
+	uint8_t expected = 0;
+	CHECK(cnt <= MAX_PROFILES);
+	for(uint8_t r = 0; from_image && pdo_image_ok && r < MAX_PROFILES; r++)
+	{
+		if(!(pdo_image[r] & 0x80))
+		{
+			continue;
+		}
+		const PDProfile *p = &supported_profiles[expected++];
+		uint16_t ma = current_ma[pdo_image[r] & 0x0F];
+		CHECK(p->voltage == pdo_src[r]);
+		CHECK(p->current == ma);
+		CHECK(p->power == ((uint32_t)pdo_volts[r] * ma + 999) / 1000);
+		CHECK(p->power > 0 && p->power <= 100);
+	}
+	CHECK(cnt == expected);
+	for(uint8_t i = cnt; i < MAX_PROFILES; i++)
+	{
+		const PDProfile *p = &supported_profiles[i];
+		CHECK(p->voltage == PD_NOT_SELECTED && p->current == 0 && p->power == 0);
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Calls every status getter and checks its result against the served register.
+ */
+/**************************************************************************/
+static void check_getters(void)
+{
+	bool cc = husb238_getCCDirection();
+	CHECK(cc == (last_value >> 7));
+	bool attached = husb238_isAttached();
+	CHECK(attached == ((last_value >> 6) & 0x01));
+	uint8_t response = husb238_getPDRespone();
+	CHECK(response <= 0x07 && response == ((last_value >> 3) & 0x07));
+	bool five_volt = husb238_get5VContractV();
+	CHECK(five_volt == ((last_value >> 2) & 0x01));
+	uint8_t five_volt_a = husb238_get5VContractA();
+	CHECK(five_volt_a <= 0x03 && five_volt_a == (last_value & 0x03));
+
+	uint16_t voltage = husb238_getPDSrcVoltage();
+	CHECK(voltage == status0_src(last_value));
+	uint16_t current = husb238_getPDSrcCurrent();
+	CHECK(current >= 500 && current <= 5000 && current == current_ma[last_value & 0x0F]);
+	uint8_t selected = husb238_getSelectedPD();
+	CHECK(selected <= 0x0F && selected == (last_value >> 4));
+}
+
+/**************************************************************************/
+/**
+ * @brief Runs one fuzz input through init, enumeration and the state machine.
+ */
+/**************************************************************************/
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	input = data;
+	input_len = size;
+	input_pos = 0;
+	host_set_time_us(0);
+	husb238_setTransport(&fuzz_transport);
+
+	uint8_t requested = PD_NOT_SELECTED;
+	if(next_byte(&requested))
+	{
+		requested &= 0x0F;
+	}
+
+	int8_t init = husb238_init(NULL);
+	CHECK(init >= -2 && init <= MAX_PROFILES);
+	if(init > 0)
+	{
+		check_profiles(init, true);
+	}
+	check_profiles(husb238_getSupportedVoltages(), true);
+
+	husb238_conn_init(DEBOUNCE_US);
+	husb238_conn_request(requested);
+	uint8_t state = husb238_conn_getState();
+	uint64_t elapsed_us = 0;
+	for(uint32_t i = 0; i < MAX_POLLS && input_pos < input_len; i++)
+	{
+		// Zeit bis zum nächsten Poll: bis etwa 1s, damit Timeout und Backoff erreicht werden
+		uint8_t step = 0;
+		next_byte(&step);
+		host_advance_us((uint64_t)step * 4096 + 1);
+		elapsed_us += (uint64_t)step * 4096 + 1;
+
+		if(state != HUSB238_CONN_ATTACHED)
+		{
+			pdo_reads = 0;
+		}
+		if(state != HUSB238_CONN_CAPS_KNOWN)
+		{
+			requests = 0;
+		}
+		transactions = 0;
+		uint8_t prev_state = state;
+		state = husb238_conn_poll(time_us_32());
+
+		CHECK(state <= HUSB238_CONN_ERROR);
+		CHECK(state == husb238_conn_getState());
+		CHECK(transactions <= MAX_TRANSACTIONS_POLL);
+		CHECK(pdo_reads <= HUSB238_CONN_MAX_RETRIES);
+		CHECK(requests <= HUSB238_CONN_MAX_RETRIES);
+		CHECK(husb238_conn_getRestoreTime() <= elapsed_us);
+		if(state == HUSB238_CONN_DETACHED)
+		{
+			// Nach einem Abstecken darf kein Profil des alten Ladegeräts übrig sein
+			CHECK(husb238_conn_getProfileCount() == 0);
+			if(prev_state != HUSB238_CONN_DETACHED)
+			{
+				check_profiles(0, false);
+			}
+		}
+		else if(state != HUSB238_CONN_ATTACHED && state != HUSB238_CONN_ERROR)
+		{
+			check_profiles(husb238_conn_getProfileCount(), true);
+		}
+		check_getters();
+	}
+	return 0;
+}
+
+#ifdef HUSB238_FUZZ_STANDALONE
+// Eigener Treiber ohne libFuzzer: Dateien (z.B. von AFL mit @@), stdin mit "-"
+// oder zufällige Eingaben mit "-runs=N"
+
+/**************************************************************************/
+/**
+ * @brief Runs one file (or stdin for "-") through the fuzz target.
+ */
+/**************************************************************************/
+static int run_file(const char *path)
+{
+	static uint8_t buf[1 << 16];
+	FILE *f = strcmp(path, "-") == 0 ? stdin : fopen(path, "rb");
+	if(f == NULL)
+	{
+		fprintf(stderr, "cannot open %s\n", path);
+		return 1;
+	}
+	size_t len = fread(buf, 1, sizeof(buf), f);
+	if(f != stdin)
+	{
+		fclose(f);
+	}
+	return LLVMFuzzerTestOneInput(buf, len);
+}
+
+int main(int argc, char **argv)
+{
+	uint32_t runs = 100000;
+	uint32_t files = 0;
+	for(int i = 1; i < argc; i++)
+	{
+		if(strncmp(argv[i], "-runs=", 6) == 0)
+		{
+			runs = strtoul(argv[i] + 6, NULL, 10);
+		}
+		else
+		{
+			if(run_file(argv[i]) != 0)
+			{
+				return 1;
+			}
+			files++;
+		}
+	}
+	if(files > 0)
+	{
+		return 0;
+	}
+
+	static uint8_t buf[1024];
+	uint32_t rng = 4711;
+	struct timespec start, end;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for(uint32_t r = 0; r < runs; r++)
+	{
+		rng = rng * 1103515245 + 12345;
+		size_t len = (rng >> 16) % sizeof(buf);
+		for(size_t i = 0; i < len; i++)
+		{
+			rng = rng * 1103515245 + 12345;
+			buf[i] = rng >> 16;
+			// Meist gültige Transaktionen, damit die Zustandsmaschine weit kommt
+			if((rng >> 8) & 0x01)
+			{
+				buf[i] |= 0x01;
+			}
+		}
+		LLVMFuzzerTestOneInput(buf, len);
+	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	printf("%u runs in %.2f s, %.0f execs/sec\n", runs, seconds, seconds > 0 ? runs / seconds : 0.0);
+	return 0;
+}
+#endif // HUSB238_FUZZ_STANDALONE
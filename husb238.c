@@ -9,18 +9,19 @@
 #define PD_18V				0b0101		///< 18V
 #define PD_20V				0b0110		///< 20V
 
+_Static_assert(HUSB238_SRC_PDO_20V - HUSB238_SRC_PDO_5V + 1 == MAX_PROFILES, "one supported_profiles entry per PDO register");
+
 // Globale I2C-Instanz
 static i2c_inst_t *i2c_instance = NULL;
 
-// Struktur für das Power Delivery (PD) Profil
-typedef struct {
-    uint8_t voltage;   ///< Voltagelevel in Volt, z.B. 5, 9, 12, 15, 18, 20V
-    uint16_t current;  ///< Current in Milliampere (mA), z.B. 500, 1000, 2000 (für 0.5A, 1A, 2A)
-	uint8_t power;	 ///< Power in Watt (W), z.B. 5, 9, 12, 15, 18, 20W
-} PDProfile;
-
 PDProfile supported_profiles[MAX_PROFILES]; ///< Array für die unterstützten PD-Profile
 
+static bool i2c_transport_write(uint8_t reg, uint8_t value, void *ctx);
+static bool i2c_transport_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx);
+
+static const HUSB238Transport i2c_transport = {i2c_transport_write, i2c_transport_read, NULL};	///< Default transport over I2C
+static const HUSB238Transport *transport = &i2c_transport;	///< Active transport
+
 /**************************************************************************/
 /**
  * @brief Parses the provided current value and returns the corresponding current in milliamps.
@@ -140,6 +141,73 @@ static uint8_t parse_voltage(uint8_t voltage)
 	}
 }
 
+/**************************************************************************/
+/**
+ * @brief Writes one register over I2C. Default `write` function of the transport.
+ */
+/**************************************************************************/
+static bool i2c_transport_write(uint8_t reg, uint8_t value, void *ctx)
+{
+	uint8_t buffer[2] = {reg, value};
+	int result = i2c_write_blocking(i2c_instance, HUSB238_I2C_ADDRESS, buffer, 2, false);
+	return result == 2;
+}
+
+/**************************************************************************/
+/**
+ * @brief Reads `len` registers starting at `reg` over I2C. Default `read` function
+ * of the transport.
+ */
+/**************************************************************************/
+static bool i2c_transport_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx)
+{
+	int result = i2c_write_blocking(i2c_instance, HUSB238_I2C_ADDRESS, &reg, 1, true);
+	if (result != 1)
+	{
+		return false;
+	}
+
+	result = i2c_read_blocking(i2c_instance, HUSB238_I2C_ADDRESS, value, len, false);
+	return result == len;
+}
+
+/**************************************************************************/
+/**
+ * @brief Replaces the transport used by `husb238_read_register()` and `husb238_write_register()`.
+ *
+ * @param transport The new transport, or `NULL` to restore the default I2C transport.
+ *                  The structure must stay valid while it is in use.
+ *
+ * @details All register access of the library goes through the transport. This allows
+ * to record the bus traffic, to replay a recorded trace, or to run the driver against a
+ * simulated device. The I2C instance set by `husb238_init()` is only used by the
+ * default transport.
+ *
+ * Example:
+ * ```
+ * static bool my_write(uint8_t reg, uint8_t value, void *ctx) { ... }
+ * static bool my_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx) { ... }
+ * static const HUSB238Transport my_transport = {my_write, my_read, NULL};
+ *
+ * husb238_setTransport(&my_transport);
+ * ```
+ */
+/**************************************************************************/
+void husb238_setTransport(const HUSB238Transport *new_transport)
+{
+	transport = new_transport != NULL ? new_transport : &i2c_transport;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the transport currently in use.
+ */
+/**************************************************************************/
+const HUSB238Transport *husb238_getTransport()
+{
+	return transport;
+}
+
 /**************************************************************************/
 /**
  * @brief Writes a value to a specified register on the HUSB238 device.
@@ -170,9 +238,7 @@ static uint8_t parse_voltage(uint8_t voltage)
 /**************************************************************************/
 bool husb238_write_register(uint8_t reg, uint8_t value)
 {
-	uint8_t buffer[2] = {reg, value};
-	int result = i2c_write_blocking(i2c_instance, HUSB238_I2C_ADDRESS, buffer, 2, false);
-	return result == 2;
+	return transport->write(reg, value, transport->ctx);
 }
 
 /**************************************************************************/
@@ -208,14 +274,38 @@ bool husb238_write_register(uint8_t reg, uint8_t value)
 /**************************************************************************/
 bool husb238_read_register(uint8_t reg, uint8_t *value)
 {
-	int result = i2c_write_blocking(i2c_instance, HUSB238_I2C_ADDRESS, &reg, 1, true);
-	if (result != 1)
-	{
-		return false;
-	}
+	return transport->read(reg, value, 1, transport->ctx);
+}
 
-	result = i2c_read_blocking(i2c_instance, HUSB238_I2C_ADDRESS, value, 1, false);
-	return result == 1;
+/**************************************************************************/
+/**
+ * @brief Reads consecutive registers from the HUSB238 device in one transaction.
+ *
+ * @param reg The first register address to read from.
+ * @param value Pointer to a buffer of at least `len` bytes for the register values.
+ * @param len The number of registers to read.
+ * 
+ * @return bool
+ *         `true` if all register values were successfully read, 
+ *         `false` if an error occurred during the read operation.
+ *
+ * @details This function selects the register address `reg` and reads `len` bytes,
+ * relying on the register address auto-increment of the HUSB238. Compared to
+ * `len` calls of `husb238_read_register()`, this saves the address phase and the
+ * bus turnaround of every register but the first.
+ *
+ * Example:
+ * ```
+ * uint8_t status[2];
+ * if (husb238_read_registers(HUSB238_PD_STATUS0, status, 2)) {
+ *     // status[0] = PD_STATUS0, status[1] = PD_STATUS1
+ * }
+ * ```
+ */
+/**************************************************************************/
+bool husb238_read_registers(uint8_t reg, uint8_t *value, uint8_t len)
+{
+	return transport->read(reg, value, len, transport->ctx);
 }
 
 /**************************************************************************/
@@ -405,7 +495,34 @@ uint16_t husb238_getPDSrcVoltage()
 {
 	uint8_t reg_value = 0;
 	husb238_read_register(HUSB238_PD_STATUS0, &reg_value);
-	return parse_voltage((reg_value>>4) & 0x0F);
+	return husb238_decodePDSrcVoltage(reg_value);
+}
+
+/**************************************************************************/
+/**
+ * @brief Decodes the source voltage from a value of the `HUSB238_PD_STATUS0` register.
+ *
+ * @param pd_status0 The value of `HUSB238_PD_STATUS0`, e.g. from a burst read.
+ *
+ * @return uint8_t
+ *         The contracted voltage as `PD_SRC_*` value, or `PD_NOT_SELECTED` if there
+ *         is no PD contract.
+ *
+ * @details Same decoding as `husb238_getPDSrcVoltage()`, without a bus transaction.
+ *
+ * Example:
+ * ```
+ * uint8_t status[2];
+ * husb238_read_registers(HUSB238_PD_STATUS0, status, 2);
+ * if (husb238_decodePDSrcVoltage(status[0]) == PD_SRC_9V) {
+ *     // 9V contract
+ * }
+ * ```
+ */
+/**************************************************************************/
+uint8_t husb238_decodePDSrcVoltage(uint8_t pd_status0)
+{
+	return parse_voltage((pd_status0>>4) & 0x0F);
 }
 
 /**************************************************************************/
@@ -481,6 +598,8 @@ uint8_t husb238_getSelectedPD()
  * @details This function iterates through the `supported_voltage` array, which contains
  * the voltage profiles detected by the `husb238_getSupportedVoltages()` function. If the
  * specified voltage (`pd_src`) matches any entry in the array, the function returns `true`.
+ * Empty entries hold `PD_NOT_SELECTED`, so `PD_NOT_SELECTED` itself is never reported
+ * as detected.
  *
  * Usage:
  * - Call this function to verify if a specific voltage is available before attempting
@@ -498,6 +617,10 @@ uint8_t husb238_getSelectedPD()
 /**************************************************************************/
 bool husb238_isVoltageDetected(uint8_t pd_src)
 {
+	if(pd_src == PD_NOT_SELECTED)
+	{
+		return false;
+	}
 	for(uint8_t i = 0; i < MAX_PROFILES; i++)
 	{
 		if(supported_profiles[i].voltage == pd_src)
@@ -508,6 +631,79 @@ bool husb238_isVoltageDetected(uint8_t pd_src)
 	return false;
 }
 
+/**************************************************************************/
+/**
+ * @brief Converts a PD source selection (e.g. `PD_SRC_9V`) into Volt.
+ *
+ * @return uint8_t
+ *         The voltage in Volt, or 0 for an invalid selection.
+ */
+/**************************************************************************/
+static uint8_t pd_src_volts(uint8_t pd_src)
+{
+	switch (pd_src)
+	{
+	case PD_SRC_5V:
+		return 5;
+	case PD_SRC_9V:
+		return 9;
+	case PD_SRC_12V:
+		return 12;
+	case PD_SRC_15V:
+		return 15;
+	case PD_SRC_18V:
+		return 18;
+	case PD_SRC_20V:
+		return 20;
+	default:
+		return 0;
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Calculates the power of a PD profile in Watt.
+ *
+ * @param pd_src The voltage of the profile (e.g. `PD_SRC_9V`).
+ * @param current_ma The current of the profile in milliamps.
+ *
+ * @return uint16_t
+ *         The power in Watt, rounded up, or 0 for an invalid voltage.
+ *
+ * @details The power is rounded up so a budget built from these values never
+ * underestimates a profile, e.g. 9V at 2.25A is 21W. `husb238_getSupportedVoltages()`
+ * stores this value in `supported_profiles` and the power budget uses the same
+ * function, so both always agree.
+ *
+ * Example:
+ * ```
+ * uint16_t watts = husb238_getProfilePower(PD_SRC_20V, 3000);	//60W
+ * ```
+ */
+/**************************************************************************/
+uint16_t husb238_getProfilePower(uint8_t pd_src, uint16_t current_ma)
+{
+	uint32_t mw = (uint32_t)pd_src_volts(pd_src) * current_ma;
+	return (mw + 999) / 1000;
+}
+
+/**************************************************************************/
+/**
+ * @brief Clears all entries of `supported_profiles`.
+ *
+ * @details After this call `husb238_isVoltageDetected()` reports no profile until
+ * `husb238_getSupportedVoltages()` is called again. Use this function when the
+ * charger is detached.
+ */
+/**************************************************************************/
+void husb238_clearSupportedVoltages()
+{
+	for(uint8_t i = 0; i < MAX_PROFILES; i++)
+	{
+		supported_profiles[i] = (PDProfile){PD_NOT_SELECTED, 0, 0};
+	}
+}
+
 /**************************************************************************/
 /**
  * @brief Retrieves the supported voltage profiles from the HUSB238 device.
@@ -519,14 +715,20 @@ bool husb238_isVoltageDetected(uint8_t pd_src)
  *         The number of supported voltage profiles detected.
  *
  * @details The function performs the following steps:
- * 1. Iterates over the source power delivery output (PDO) registers, from `HUSB238_SRC_PDO_5V`
- *    to `HUSB238_SRC_PDO_20V`.
- * 2. Reads the content of each register to determine if the voltage profile is supported
- *    by checking the 7th bit (support flag).
- * 3. If supported, stores the voltage value (parsed using `parse_voltage`) and current value 
+ * 1. Clears all entries of `supported_profiles`, so no stale profile of a previous
+ *    charger survives.
+ * 2. Reads the source power delivery output (PDO) registers, from `HUSB238_SRC_PDO_5V`
+ *    to `HUSB238_SRC_PDO_20V`, in a single burst read. If the read fails, 0 is returned.
+ * 3. Checks the 7th bit (support flag) of each register to determine if the voltage
+ *    profile is supported.
+ * 4. If supported, stores the voltage value (parsed using `parse_voltage`) and current value 
  *    (parsed using `parse_current`) into the global `supported_voltage` and `supported_current`
- *    arrays, respectively.
- * 4. Increments the support count for each detected profile.
+ *    arrays, respectively. The power is computed by `husb238_getProfilePower()`.
+ * 5. Increments the support count for each detected profile. There is one PDO register
+ *    per entry of `supported_profiles`, so the count never exceeds `MAX_PROFILES`.
+ *
+ * A failed read and a source without PDOs (e.g. a Type-C 5V source without PD) both
+ * return 0. Use `husb238_readSupportedVoltages()` to tell them apart.
  *
  * Usage:
  * - This function should be called after initializing the device to determine available
@@ -543,43 +745,58 @@ bool husb238_isVoltageDetected(uint8_t pd_src)
 /**************************************************************************/
 uint8_t husb238_getSupportedVoltages()
 {
-	uint8_t reg_value = 0;
+	uint8_t support_cnt = 0;
+	husb238_readSupportedVoltages(&support_cnt);
+	return support_cnt;
+}
+
+/**************************************************************************/
+/**
+ * @brief Retrieves the supported voltage profiles and reports whether the PDO registers
+ * could be read.
+ *
+ * @param num_profiles Receives the number of supported voltage profiles, 0 if the
+ *                     read failed.
+ *
+ * @return bool
+ *         `true` if the PDO registers were read, `false` on a bus error.
+ *
+ * @details Same as `husb238_getSupportedVoltages()`. A return value of `true` with
+ * `*num_profiles == 0` means the source offers no PDOs.
+ *
+ * Example:
+ * ```
+ * uint8_t num_profiles = 0;
+ * if (husb238_readSupportedVoltages(&num_profiles) && num_profiles == 0) {
+ *     // Source without PD, only the default 5V contract
+ * }
+ * ```
+ */
+/**************************************************************************/
+bool husb238_readSupportedVoltages(uint8_t *num_profiles)
+{
+	uint8_t pdo[HUSB238_SRC_PDO_20V - HUSB238_SRC_PDO_5V + 1] = {0};
 	uint8_t support_cnt =0;
+	husb238_clearSupportedVoltages();
+	*num_profiles = 0;
+	if(!husb238_read_registers(HUSB238_SRC_PDO_5V, pdo, sizeof(pdo)))
+	{
+		return false;
+	}
 	for(uint8_t i = HUSB238_SRC_PDO_5V; i < HUSB238_SRC_PDO_20V+1; i++)
 	{
-		husb238_read_register(i, &reg_value);
+		uint8_t reg_value = pdo[i - HUSB238_SRC_PDO_5V];
 		if(((reg_value >> 7) & 0x01) == 1)
 		{
 			supported_profiles[support_cnt].voltage = parse_voltage(i-1);
 			supported_profiles[support_cnt].current = parse_current(reg_value & 0x0F);
-			switch (i-1)
-			{
-			case PD_5V:
-				supported_profiles[support_cnt].power = 5 * supported_profiles[support_cnt].current;
-				break;
-			case PD_9V:
-				supported_profiles[support_cnt].power = 9 * supported_profiles[support_cnt].current;
-				break;
-			case PD_12V:
-				supported_profiles[support_cnt].power = 12 * supported_profiles[support_cnt].current;
-				break;
-			case PD_15V:
-				supported_profiles[support_cnt].power = 15 * supported_profiles[support_cnt].current;
-				break;
-			case PD_18V:
-				supported_profiles[support_cnt].power = 18 * supported_profiles[support_cnt].current;
-				break;
-			case PD_20V:
-				supported_profiles[support_cnt].power = 20 * supported_profiles[support_cnt].current;
-				break;
-			default:
-				supported_profiles[support_cnt].power = 0;
-				break;
-			}
+			supported_profiles[support_cnt].power = husb238_getProfilePower(supported_profiles[support_cnt].voltage,
+				supported_profiles[support_cnt].current);
 			support_cnt++;
 		}
 	}
-	return support_cnt;
+	*num_profiles = support_cnt;
+	return true;
 }
 
 /**************************************************************************/
@@ -587,12 +804,13 @@ uint8_t husb238_getSupportedVoltages()
 	@brief  Selects a PD output.
 	@param pd The PD selection as an HUSB238_PDOelection enum value.
 	@details This function writes to bits 4-7 of the SRC_PDO register to select
-   a PD.
+   a PD. Only the lower 4 bits of pd_src are used.
+	@return true if the register was written, false on a bus error.
 */
 /**************************************************************************/
-void husb2238_selectPD(uint8_t pd_src)
+bool husb2238_selectPD(uint8_t pd_src)
 {
-	husb238_write_register(HUSB238_SRC_PDO, pd_src << 4);
+	return husb238_write_register(HUSB238_SRC_PDO, (pd_src & 0x0F) << 4);
 }
 
 /**************************************************************************/
@@ -600,11 +818,12 @@ void husb2238_selectPD(uint8_t pd_src)
 	@brief  Requests a PD.
 	@details This function writes 0b00001 to the GO_COMMAND register to request
    a PD.
+	@return true if the register was written, false on a bus error.
 */
 /**************************************************************************/
-void husb238_requestPD()
+bool husb238_requestPD()
 {
-	husb238_write_register(HUSB238_GO_COMMAND, 0b00001);
+	return husb238_write_register(HUSB238_GO_COMMAND, 0b00001);
 }
 
 /**************************************************************************/
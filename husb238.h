@@ -59,11 +59,32 @@
 
 #define MAX_PROFILES	6	///< Maximum number of supported PD profiles
 
+// Struktur für das Power Delivery (PD) Profil
+typedef struct {
+    uint8_t voltage;   ///< Voltagelevel in Volt, z.B. 5, 9, 12, 15, 18, 20V
+    uint16_t current;  ///< Current in Milliampere (mA), z.B. 500, 1000, 2000 (für 0.5A, 1A, 2A)
+	uint8_t power;	 ///< Power in Watt (W), rounded up, z.B. 5, 9, 12, 15, 18, 20W
+} PDProfile;
+
+extern PDProfile supported_profiles[MAX_PROFILES]; ///< Array für die unterstützten PD-Profile
+
+// Struktur für die Bus-Anbindung (Standard: I2C)
+typedef struct {
+	bool (*write)(uint8_t reg, uint8_t value, void *ctx);			///< Writes one register
+	bool (*read)(uint8_t reg, uint8_t *value, uint8_t len, void *ctx);	///< Reads len registers starting at reg
+	void *ctx;															///< User context passed to both functions
+} HUSB238Transport;
+
+// Funktionen zum Austauschen der Bus-Anbindung
+void husb238_setTransport(const HUSB238Transport *transport);
+const HUSB238Transport *husb238_getTransport();
+
 // Funktion zum Schreiben eines Registers
 bool husb238_write_register(uint8_t reg, uint8_t value);
 
 // Funktion zum Lesen eines Registers
 bool husb238_read_register(uint8_t reg, uint8_t *value);
+bool husb238_read_registers(uint8_t reg, uint8_t *value, uint8_t len);
 
 bool husb238_getCCDirection(void);
 bool husb238_isAttached();
@@ -71,12 +92,16 @@ uint8_t husb238_getPDRespone();
 bool husb238_get5VContractV();
 uint8_t husb238_get5VContractA();
 uint16_t husb238_getPDSrcVoltage();
+uint8_t husb238_decodePDSrcVoltage(uint8_t pd_status0);
 uint16_t husb238_getPDSrcCurrent();
 uint8_t husb238_getSelectedPD();
 bool husb238_isVoltageDetected(uint8_t pd_src);
 uint8_t husb238_getSupportedVoltages();
-void husb2238_selectPD(uint8_t pd_src);
-void husb238_requestPD();
+bool husb238_readSupportedVoltages(uint8_t *num_profiles);
+void husb238_clearSupportedVoltages();
+uint16_t husb238_getProfilePower(uint8_t pd_src, uint16_t current_ma);
+bool husb2238_selectPD(uint8_t pd_src);
+bool husb238_requestPD();
 void husb238_reset();
 
 // Funktion zur Initialisierung
@@ -0,0 +1,476 @@
+#include "husb238_budget.h"
+
+#if HUSB238_BUDGET_MAX_WATTS * (HUSB238_BUDGET_MAX_SINKS + 1) + HUSB238_BUDGET_MAX_SINKS > 0xFFFF
+#error "HUSB238_BUDGET_MAX_WATTS * (HUSB238_BUDGET_MAX_SINKS + 1) must fit into uint16_t"
+#endif
+
+#define NO_OPTION	0xFF	///< Choice value for "no profile assigned"
+
+// Struktur für einen Sink, der am gemeinsamen Budget hängt
+typedef struct {
+	uint8_t num_options;				///< Number of usable profiles
+	uint8_t option_pd[MAX_PROFILES];	///< PD_SRC_* value of each profile
+	uint8_t option_w[MAX_PROFILES];		///< Power of each profile in Watt (rounded up)
+	uint16_t demand_w;					///< Power the sink would like to draw in Watt
+	uint8_t assigned;					///< Profile chosen by the last solve
+	uint8_t active;						///< Profile the sink is currently contracted to
+	uint8_t active_w;					///< Power reserved by the active profile in Watt
+} BudgetSink;
+
+static BudgetSink sinks[HUSB238_BUDGET_MAX_SINKS];	///< Registered sinks
+static uint8_t num_sinks = 0;						///< Number of registered sinks
+static uint16_t total_budget_w = 0;					///< Shared budget in Watt
+static uint16_t active_total_w = 0;					///< Sum of active_w over all sinks
+
+/// best[i][w]: best score using the first i sinks with at most w Watt
+static uint16_t best[HUSB238_BUDGET_MAX_SINKS + 1][HUSB238_BUDGET_MAX_WATTS + 1];
+/// choice[i][w]: option of sink i that produced best[i + 1][w]
+static uint8_t choice[HUSB238_BUDGET_MAX_SINKS][HUSB238_BUDGET_MAX_WATTS + 1];
+static uint8_t dirty = 0;	///< First sink whose layer in best/choice is out of date
+
+static husb238_renegotiate_fn renegotiate_cb = NULL;	///< Renegotiation callback
+static void *renegotiate_ctx = NULL;					///< User context for the callback
+static uint32_t stagger_interval_us = 0;				///< Minimum time between renegotiations
+static uint32_t last_issue_us = 0;						///< Time of the last renegotiation
+static bool issued = false;								///< A renegotiation has been issued
+
+/**************************************************************************/
+/**
+ * @brief Marks the DP layers from `sink` onwards as out of date.
+ */
+/**************************************************************************/
+static void mark_dirty(uint8_t sink)
+{
+	if(sink < dirty)
+	{
+		dirty = sink;
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the score of assigning option `opt` to sink `s`.
+ *
+ * @details The score is the delivered power (limited by the demand), scaled so
+ * that one Watt always outweighs the sum of all tie-break bonuses. A sink that
+ * keeps its active profile gets a bonus of 1, which keeps the number of
+ * renegotiations minimal among equally good assignments.
+ */
+/**************************************************************************/
+static uint16_t option_score(const BudgetSink *s, uint8_t opt)
+{
+	if(opt == NO_OPTION)
+	{
+		return s->active == PD_NOT_SELECTED ? 1 : 0;
+	}
+	uint16_t delivered = s->option_w[opt] < s->demand_w ? s->option_w[opt] : s->demand_w;
+	return delivered * (HUSB238_BUDGET_MAX_SINKS + 1) + (s->option_pd[opt] == s->active ? 1 : 0);
+}
+
+/**************************************************************************/
+/**
+ * @brief Recomputes the DP layer of one sink from the layer before it.
+ */
+/**************************************************************************/
+static void solve_layer(uint8_t i)
+{
+	const BudgetSink *s = &sinks[i];
+	for(uint16_t w = 0; w <= HUSB238_BUDGET_MAX_WATTS; w++)
+	{
+		uint16_t best_score = best[i][w] + option_score(s, NO_OPTION);
+		uint8_t best_opt = NO_OPTION;
+		for(uint8_t k = 0; k < s->num_options; k++)
+		{
+			if(s->option_w[k] > w)
+			{
+				continue;
+			}
+			uint16_t score = best[i][w - s->option_w[k]] + option_score(s, k);
+			if(score > best_score)
+			{
+				best_score = score;
+				best_opt = k;
+			}
+		}
+		best[i + 1][w] = best_score;
+		choice[i][w] = best_opt;
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the power of profile `pd_src` of sink `s` in Watt.
+ *
+ * @return int16_t
+ *         The power in Watt, 0 for `PD_NOT_SELECTED`, or -1 if the sink has no such profile.
+ */
+/**************************************************************************/
+static int16_t profile_watts(const BudgetSink *s, uint8_t pd_src)
+{
+	if(pd_src == PD_NOT_SELECTED)
+	{
+		return 0;
+	}
+	for(uint8_t k = 0; k < s->num_options; k++)
+	{
+		if(s->option_pd[k] == pd_src)
+		{
+			return s->option_w[k];
+		}
+	}
+	return -1;
+}
+
+/**************************************************************************/
+/**
+ * @brief Initializes the power-budget orchestrator.
+ *
+ * @param total_w The power the shared charger can deliver to all sinks in Watt.
+ * @param stagger_us The minimum time between two renegotiations in microseconds.
+ * @param renegotiate Callback that switches one sink to a new profile.
+ * @param ctx User context passed to the callback.
+ *
+ * @details The orchestrator keeps a table of sinks, each with the PDO table of its
+ * HUSB238 and the power it would like to draw. `husb238_budget_solve()` computes the
+ * profile assignment that delivers the most power within the budget, and
+ * `husb238_budget_step()` applies it one sink at a time.
+ *
+ * The callback is called with `PD_NOT_SELECTED` if a sink does not fit into the
+ * budget at all; the application then has to shed that load. It returns `true` if
+ * the sink has accepted the new profile. The sinks are addressed by index, so a
+ * sink may be a local HUSB238 or a remote Pico.
+ *
+ * Example:
+ * ```
+ * static bool renegotiate(uint8_t sink, uint8_t pd_src, void *ctx) {
+ *     if (pd_src == PD_NOT_SELECTED) {
+ *         gpio_put(LOAD_ENABLE_PIN, 0);	//Shed the load, SRC_PDO has no "off" value
+ *         return true;
+ *     }
+ *     husb2238_selectPD(pd_src);
+ *     husb238_requestPD();
+ *     gpio_put(LOAD_ENABLE_PIN, 1);
+ *     return true;
+ * }
+ *
+ * husb238_budget_init(100, 50000, renegotiate, NULL);
+ * husb238_budget_addSink(supported_profiles, husb238_getSupportedVoltages(), 45);
+ * ```
+ */
+/**************************************************************************/
+void husb238_budget_init(uint16_t total_w, uint32_t stagger_us, husb238_renegotiate_fn renegotiate, void *ctx)
+{
+	num_sinks = 0;
+	active_total_w = 0;
+	dirty = 0;
+	issued = false;
+	renegotiate_cb = renegotiate;
+	renegotiate_ctx = ctx;
+	stagger_interval_us = stagger_us;
+	husb238_budget_setTotal(total_w);
+	for(uint16_t w = 0; w <= HUSB238_BUDGET_MAX_WATTS; w++)
+	{
+		best[0][w] = 0;
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Changes the shared budget.
+ *
+ * @param total_w The new budget in Watt, limited to `HUSB238_BUDGET_MAX_WATTS`.
+ *
+ * @details The DP table covers every budget up to `HUSB238_BUDGET_MAX_WATTS`, so
+ * a budget change does not need a re-solve of any layer.
+ */
+/**************************************************************************/
+void husb238_budget_setTotal(uint16_t total_w)
+{
+	total_budget_w = total_w > HUSB238_BUDGET_MAX_WATTS ? HUSB238_BUDGET_MAX_WATTS : total_w;
+}
+
+/**************************************************************************/
+/**
+ * @brief Registers a sink with the orchestrator.
+ *
+ * @param profiles The PDO table of the sink, as filled by `husb238_getSupportedVoltages()`.
+ * @param num_profiles The number of valid entries in `profiles`.
+ * @param demand_w The power the sink would like to draw in Watt.
+ *
+ * @return int8_t
+ *         The index of the new sink, or `HUSB238_BUDGET_NO_SINK` if all slots are in use.
+ *
+ * @details The sink starts without an active profile. Use `husb238_budget_setActive()`
+ * if it already holds a contract.
+ */
+/**************************************************************************/
+int8_t husb238_budget_addSink(const PDProfile *profiles, uint8_t num_profiles, uint16_t demand_w)
+{
+	if(num_sinks >= HUSB238_BUDGET_MAX_SINKS)
+	{
+		return HUSB238_BUDGET_NO_SINK;
+	}
+	uint8_t sink = num_sinks++;
+	sinks[sink].assigned = PD_NOT_SELECTED;
+	sinks[sink].active = PD_NOT_SELECTED;
+	sinks[sink].active_w = 0;
+	sinks[sink].demand_w = demand_w;
+	husb238_budget_setProfiles(sink, profiles, num_profiles);
+	return sink;
+}
+
+/**************************************************************************/
+/**
+ * @brief Replaces the PDO table of a sink, e.g. after it was plugged into another port.
+ *
+ * @return bool
+ *         `true` on success, `false` if `sink` is not registered.
+ *
+ * @details Profiles with an invalid voltage or current, and profiles that exceed
+ * `HUSB238_BUDGET_MAX_WATTS`, are ignored. If the new table no longer has the active
+ * profile, the sink is treated as having no contract and its power is released. An
+ * assigned profile that is gone is dropped until the next `husb238_budget_solve()`.
+ */
+/**************************************************************************/
+bool husb238_budget_setProfiles(uint8_t sink, const PDProfile *profiles, uint8_t num_profiles)
+{
+	if(sink >= num_sinks)
+	{
+		return false;
+	}
+	BudgetSink *s = &sinks[sink];
+	s->num_options = 0;
+	for(uint8_t i = 0; i < num_profiles && i < MAX_PROFILES; i++)
+	{
+		uint16_t w = husb238_getProfilePower(profiles[i].voltage, profiles[i].current);
+		if(w == 0 || w > HUSB238_BUDGET_MAX_WATTS)
+		{
+			continue;
+		}
+		s->option_pd[s->num_options] = profiles[i].voltage;
+		s->option_w[s->num_options] = w;
+		s->num_options++;
+	}
+
+	// Aktives Profil mit der neuen Tabelle abgleichen
+	int16_t active_w = profile_watts(s, s->active);
+	if(active_w < 0)
+	{
+		s->active = PD_NOT_SELECTED;
+		active_w = 0;
+	}
+	active_total_w = active_total_w - s->active_w + active_w;
+	s->active_w = active_w;
+	if(profile_watts(s, s->assigned) < 0)
+	{
+		s->assigned = s->active;
+	}
+	mark_dirty(sink);
+	return true;
+}
+
+/**************************************************************************/
+/**
+ * @brief Changes the power a sink would like to draw.
+ *
+ * @return bool
+ *         `true` on success, `false` if `sink` is not registered.
+ *
+ * @details Only the DP layers from `sink` onwards are recomputed by the next
+ * `husb238_budget_solve()`. Sinks whose demand changes often should therefore
+ * be registered last.
+ */
+/**************************************************************************/
+bool husb238_budget_setDemand(uint8_t sink, uint16_t demand_w)
+{
+	if(sink >= num_sinks)
+	{
+		return false;
+	}
+	if(sinks[sink].demand_w != demand_w)
+	{
+		sinks[sink].demand_w = demand_w;
+		mark_dirty(sink);
+	}
+	return true;
+}
+
+/**************************************************************************/
+/**
+ * @brief Tells the orchestrator which profile a sink is currently contracted to.
+ *
+ * @return bool
+ *         `true` on success, `false` if `sink` is not registered or has no such profile.
+ */
+/**************************************************************************/
+bool husb238_budget_setActive(uint8_t sink, uint8_t pd_src)
+{
+	if(sink >= num_sinks)
+	{
+		return false;
+	}
+	BudgetSink *s = &sinks[sink];
+	int16_t w = profile_watts(s, pd_src);
+	if(w < 0)
+	{
+		return false;
+	}
+	active_total_w = active_total_w - s->active_w + w;
+	s->active = pd_src;
+	s->active_w = w;
+	mark_dirty(sink);
+	return true;
+}
+
+/**************************************************************************/
+/**
+ * @brief Computes the profile assignment that delivers the most power within the budget.
+ *
+ * @return uint16_t
+ *         The total power delivered by the new assignment in Watt.
+ *
+ * @details Each sink may take one of its profiles or none. The delivered power of a
+ * profile is its power limited by the demand of the sink, and the reserved power is
+ * the full profile power. The assignment is found with a multiple-choice knapsack
+ * DP over whole Watt, O(sinks * profiles * HUSB238_BUDGET_MAX_WATTS). The layers of
+ * unchanged sinks before the first changed one are reused, so a demand change of
+ * the last sink costs a single layer. Among equal assignments, the one that uses
+ * the least power and keeps the most active profiles is chosen.
+ *
+ * Usage:
+ * - Call this function after changing demands or profiles, then call
+ *   `husb238_budget_step()` periodically to apply the assignment.
+ */
+/**************************************************************************/
+uint16_t husb238_budget_solve()
+{
+	for(uint8_t i = dirty; i < num_sinks; i++)
+	{
+		solve_layer(i);
+	}
+	dirty = num_sinks;
+
+	uint16_t w = total_budget_w;
+	while(w > 0 && best[num_sinks][w - 1] == best[num_sinks][w])
+	{
+		w--;
+	}
+
+	uint16_t delivered = 0;
+	for(int16_t i = num_sinks - 1; i >= 0; i--)
+	{
+		BudgetSink *s = &sinks[i];
+		uint8_t opt = choice[i][w];
+		if(opt == NO_OPTION)
+		{
+			s->assigned = PD_NOT_SELECTED;
+			continue;
+		}
+		s->assigned = s->option_pd[opt];
+		w -= s->option_w[opt];
+		delivered += option_score(s, opt) / (HUSB238_BUDGET_MAX_SINKS + 1);
+	}
+	return delivered;
+}
+
+/**************************************************************************/
+/**
+ * @brief Applies the assignment of the last solve, one renegotiation at a time.
+ *
+ * @param now_us The current time in microseconds, e.g. `time_us_32()`.
+ *
+ * @return uint8_t
+ *         The number of sinks whose active profile still differs from the assignment.
+ *
+ * @details Only sinks whose assigned profile differs from the active one are
+ * renegotiated, and at most one per `stagger_us`. Sinks that lower their power are
+ * switched first, largest drop first. A sink that raises its power is only switched
+ * once the sum of active profiles stays within the budget, so the charger is never
+ * overcommitted during the transition.
+ *
+ * Example:
+ * ```
+ * while (husb238_budget_step(time_us_32()) > 0) {
+ *     sleep_ms(1);
+ * }
+ * ```
+ */
+/**************************************************************************/
+uint8_t husb238_budget_step(uint32_t now_us)
+{
+	uint8_t pending = 0;
+	int16_t next = -1;
+	int16_t next_delta = 0;
+	for(uint8_t i = 0; i < num_sinks; i++)
+	{
+		BudgetSink *s = &sinks[i];
+		if(s->assigned == s->active)
+		{
+			continue;
+		}
+		pending++;
+		int16_t assigned_w = profile_watts(s, s->assigned);
+		if(assigned_w < 0)
+		{
+			continue;
+		}
+		int16_t delta = assigned_w - s->active_w;
+		if(delta > 0 && active_total_w + delta > total_budget_w)
+		{
+			continue;
+		}
+		if(next < 0 || delta < next_delta)
+		{
+			next = i;
+			next_delta = delta;
+		}
+	}
+
+	if(next < 0 || renegotiate_cb == NULL)
+	{
+		return pending;
+	}
+	if(issued && (now_us - last_issue_us) < stagger_interval_us)
+	{
+		return pending;
+	}
+
+	BudgetSink *s = &sinks[next];
+	issued = true;
+	last_issue_us = now_us;
+	if(renegotiate_cb(next, s->assigned, renegotiate_ctx) && husb238_budget_setActive(next, s->assigned))
+	{
+		pending--;
+	}
+	return pending;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the profile assigned to a sink by the last solve, or `PD_NOT_SELECTED`.
+ */
+/**************************************************************************/
+uint8_t husb238_budget_getAssigned(uint8_t sink)
+{
+	return sink < num_sinks ? sinks[sink].assigned : PD_NOT_SELECTED;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the profile a sink is currently contracted to, or `PD_NOT_SELECTED`.
+ */
+/**************************************************************************/
+uint8_t husb238_budget_getActive(uint8_t sink)
+{
+	return sink < num_sinks ? sinks[sink].active : PD_NOT_SELECTED;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the power reserved by all active profiles in Watt.
+ */
+/**************************************************************************/
+uint16_t husb238_budget_getActivePower()
+{
+	return active_total_w;
+}
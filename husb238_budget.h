@@ -0,0 +1,36 @@
+#ifndef HUSB238_BUDGET_H
+#define HUSB238_BUDGET_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "husb238.h"
+
+#ifndef HUSB238_BUDGET_MAX_SINKS
+#define HUSB238_BUDGET_MAX_SINKS	24	///< Maximum number of HUSB238 sinks sharing one budget
+#endif
+
+#ifndef HUSB238_BUDGET_MAX_WATTS
+#define HUSB238_BUDGET_MAX_WATTS	240	///< Maximum total budget in Watt (W)
+#endif
+
+#define HUSB238_BUDGET_NO_SINK		-1	///< Returned by husb238_budget_addSink() if no slot is left
+
+// Callback zum Umschalten eines Sinks auf ein neues Profil (PD_NOT_SELECTED = abschalten)
+typedef bool (*husb238_renegotiate_fn)(uint8_t sink, uint8_t pd_src, void *ctx);
+
+// Funktionen zur Konfiguration
+void husb238_budget_init(uint16_t total_w, uint32_t stagger_us, husb238_renegotiate_fn renegotiate, void *ctx);
+void husb238_budget_setTotal(uint16_t total_w);
+int8_t husb238_budget_addSink(const PDProfile *profiles, uint8_t num_profiles, uint16_t demand_w);
+bool husb238_budget_setProfiles(uint8_t sink, const PDProfile *profiles, uint8_t num_profiles);
+bool husb238_budget_setDemand(uint8_t sink, uint16_t demand_w);
+bool husb238_budget_setActive(uint8_t sink, uint8_t pd_src);
+
+// Funktionen zur Berechnung und Umsetzung
+uint16_t husb238_budget_solve();
+uint8_t husb238_budget_step(uint32_t now_us);
+uint8_t husb238_budget_getAssigned(uint8_t sink);
+uint8_t husb238_budget_getActive(uint8_t sink);
+uint16_t husb238_budget_getActivePower();
+
+#endif // HUSB238_BUDGET_H
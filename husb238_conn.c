@@ -0,0 +1,330 @@
+#include "husb238_conn.h"
+
+static uint8_t state = HUSB238_CONN_DETACHED;	///< Current connection state
+static uint32_t state_since_us = 0;				///< Time the current state (or negotiation) was entered
+static uint8_t retries = 0;						///< Failed attempts in the current state
+
+static uint32_t debounce_interval_us = 0;	///< Time the attach bit has to be stable
+static bool raw_attached = false;			///< Last sampled attach bit
+static uint32_t raw_since_us = 0;			///< Time the attach bit last changed
+
+static uint8_t requested_pd = PD_NOT_SELECTED;	///< Last profile requested by the application
+static bool negotiating = false;				///< A PD request is on its way
+static uint8_t request_response = NO_RESPONSE;	///< PD response present when the request was issued
+static bool response_changed = false;			///< PD response changed since the request was issued
+static uint8_t contract_voltage = 0xFF;			///< Contracted PD_SRC_* voltage from PD_STATUS0, 0xFF = unknown
+static uint8_t profile_cnt = 0;					///< Number of profiles found by the last enumeration
+
+static bool restoring = false;		///< Waiting for the first contract after an attach
+static bool attach_seen = false;	///< An attach edge was seen since the last debounced detach
+static uint32_t first_attach_us = 0;	///< Time of the first attach edge since the last debounced detach
+static uint32_t attach_us = 0;		///< Time of the attach edge that started the restore
+static uint32_t restore_time_us = 0;	///< Duration of the last replug to contract
+
+/**************************************************************************/
+/**
+ * @brief Switches to a new state and restarts the retry counter.
+ */
+/**************************************************************************/
+static void enter_state(uint8_t new_state, uint32_t now_us)
+{
+	state = new_state;
+	state_since_us = now_us;
+	retries = 0;
+	negotiating = false;
+	contract_voltage = 0xFF;
+}
+
+/**************************************************************************/
+/**
+ * @brief Switches to `HUSB238_CONN_CONTRACTED`, records the restore time after a replug
+ * and remembers the contracted voltage from `HUSB238_PD_STATUS0`.
+ */
+/**************************************************************************/
+static void enter_contracted(uint32_t now_us, bool status_ok, uint8_t status0)
+{
+	if(restoring)
+	{
+		restore_time_us = now_us - attach_us;
+		restoring = false;
+	}
+	enter_state(HUSB238_CONN_CONTRACTED, now_us);
+	if(status_ok)
+	{
+		contract_voltage = husb238_decodePDSrcVoltage(status0);
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Initializes the connection state machine.
+ *
+ * @param debounce_us The time the attach status has to be stable before an attach
+ *                    or detach is accepted, in microseconds.
+ *
+ * @details The state machine uses the I2C instance set by `husb238_init()` (or the
+ * transport set by `husb238_setTransport()`), so `husb238_init()` has to be called
+ * first. Its return value does not matter; the state machine takes over from there.
+ * The requested profile is kept across calls.
+ */
+/**************************************************************************/
+void husb238_conn_init(uint32_t debounce_us)
+{
+	debounce_interval_us = debounce_us;
+	raw_attached = false;
+	raw_since_us = 0;
+	profile_cnt = 0;
+	restoring = false;
+	attach_seen = false;
+	restore_time_us = 0;
+	enter_state(HUSB238_CONN_DETACHED, 0);
+}
+
+/**************************************************************************/
+/**
+ * @brief Requests a PD profile that is negotiated now and restored after every replug.
+ *
+ * @param pd_src The profile to request (e.g. `PD_SRC_9V`), or `PD_NOT_SELECTED` to
+ *               stay on the default 5V contract.
+ *
+ * @details The request is remembered. If a charger is attached, the profile is
+ * negotiated by the next `husb238_conn_poll()`. If the charger does not offer the
+ * profile, the state machine stays in `HUSB238_CONN_CAPS_KNOWN` until the next
+ * charger is attached or another profile is requested.
+ *
+ * Example:
+ * ```
+ * husb238_conn_request(PD_SRC_12V);
+ * ```
+ */
+/**************************************************************************/
+void husb238_conn_request(uint8_t pd_src)
+{
+	requested_pd = pd_src;
+	if(state == HUSB238_CONN_CONTRACTED || state == HUSB238_CONN_CAPS_KNOWN)
+	{
+		// Ohne bekannte Profile zuerst neu einlesen
+		enter_state(profile_cnt > 0 ? HUSB238_CONN_CAPS_KNOWN : HUSB238_CONN_ATTACHED, state_since_us);
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Runs one step of the connection state machine.
+ *
+ * @param now_us The current time in microseconds, e.g. `time_us_32()`.
+ *
+ * @return uint8_t
+ *         The new state (`HUSB238_CONN_DETACHED`, `HUSB238_CONN_ATTACHED`,
+ *         `HUSB238_CONN_CAPS_KNOWN`, `HUSB238_CONN_CONTRACTED` or `HUSB238_CONN_ERROR`).
+ *
+ * @details Each call reads `HUSB238_PD_STATUS0` and `HUSB238_PD_STATUS1` with one
+ * burst read and debounces the attach bit.
+ * The state machine then advances as far as it can in one call:
+ * 1. detached -> attached once the attach bit has been set for the debounce time.
+ * 2. attached -> capabilities known after the PDO registers were read with one
+ *    burst read by `husb238_readSupportedVoltages()`. A source without PDOs (a
+ *    Type-C 5V source without PD) is accepted if nothing is requested or the 5V
+ *    contract bit in `HUSB238_PD_STATUS1` is set, so it is not retried forever.
+ * 3. capabilities known -> contracted once the requested profile is selected,
+ *    requested and reported in `HUSB238_PD_STATUS0`. The contract is checked on the
+ *    status read of the poll, without another bus transaction.
+ * 4. contracted -> capabilities known if the voltage in `HUSB238_PD_STATUS0`
+ *    changes without a detach, so the lost contract is negotiated again.
+ * 5. Any state -> detached once the attach bit has been cleared for the debounce
+ *    time. `supported_profiles` is cleared, the requested profile is kept.
+ *
+ * A failed enumeration, a PD request that could not be written, or a rejected or
+ * timed out PD request is retried up to
+ * `HUSB238_CONN_MAX_RETRIES` times before the error state is entered. After
+ * `HUSB238_CONN_ERROR_BACKOFF_US` the enumeration starts again. A failure code in
+ * the PD response only counts once the response has changed after the request,
+ * so the code of the previous attempt is not counted again; a request that fails
+ * with the same code again is caught by `HUSB238_CONN_CONTRACT_TIMEOUT_US`.
+ *
+ * The time from the first attach edge after a detach to the restored contract,
+ * including any bouncing of the attach bit, is available from
+ * `husb238_conn_getRestoreTime()`.
+ *
+ * Usage:
+ * - Call this function periodically, e.g. every few milliseconds from the main loop.
+ *
+ * Example:
+ * ```
+ * husb238_init(i2c_instance);
+ * husb238_conn_init(100 * 1000);	//100ms debounce
+ * husb238_conn_request(PD_SRC_9V);
+ * while (true) {
+ *     if (husb238_conn_poll(time_us_32()) == HUSB238_CONN_CONTRACTED) {
+ *         // 9V available
+ *     }
+ *     sleep_ms(10);
+ * }
+ * ```
+ */
+/**************************************************************************/
+uint8_t husb238_conn_poll(uint32_t now_us)
+{
+	uint8_t status[2] = {0};
+	bool status_ok = husb238_read_registers(HUSB238_PD_STATUS0, status, 2);
+	uint8_t status0 = status[0];
+	uint8_t status1 = status[1];
+	if(status_ok)
+	{
+		bool attached = (status1 >> 6) & 0x01;
+		if(attached != raw_attached)
+		{
+			raw_attached = attached;
+			raw_since_us = now_us;
+			if(attached && state == HUSB238_CONN_DETACHED && !attach_seen)
+			{
+				attach_seen = true;
+				first_attach_us = now_us;
+			}
+		}
+	}
+
+	if((now_us - raw_since_us) < debounce_interval_us)
+	{
+		return state;
+	}
+
+	if(!raw_attached)
+	{
+		attach_seen = false;
+		if(state != HUSB238_CONN_DETACHED)
+		{
+			husb238_clearSupportedVoltages();
+			profile_cnt = 0;
+			restoring = false;
+			enter_state(HUSB238_CONN_DETACHED, now_us);
+		}
+		return state;
+	}
+
+	uint8_t prev_state = state;
+	if(state == HUSB238_CONN_DETACHED)
+	{
+		attach_us = attach_seen ? first_attach_us : raw_since_us;
+		attach_seen = false;
+		restoring = true;
+		enter_state(HUSB238_CONN_ATTACHED, now_us);
+	}
+
+	if(state == HUSB238_CONN_ATTACHED)
+	{
+		// Ohne PDOs (Type-C-Quelle ohne PD) bleibt der 5V-Vertrag
+		bool pdo_ok = husb238_readSupportedVoltages(&profile_cnt);
+		bool five_volt = status_ok && ((status1 >> 2) & 0x01);
+		if(profile_cnt > 0 || (pdo_ok && (requested_pd == PD_NOT_SELECTED || five_volt)))
+		{
+			enter_state(HUSB238_CONN_CAPS_KNOWN, now_us);
+		}
+		else if(++retries >= HUSB238_CONN_MAX_RETRIES)
+		{
+			enter_state(HUSB238_CONN_ERROR, now_us);
+		}
+	}
+
+	if(state == HUSB238_CONN_CAPS_KNOWN)
+	{
+		if(!negotiating)
+		{
+			if(requested_pd == PD_NOT_SELECTED)
+			{
+				enter_contracted(now_us, status_ok, status0);
+			}
+			else if(husb238_isVoltageDetected(requested_pd))
+			{
+				if(husb2238_selectPD(requested_pd) && husb238_requestPD())
+				{
+					negotiating = true;
+					request_response = (status1 >> 3) & 0x07;
+					response_changed = false;
+					state_since_us = now_us;
+				}
+				else if(++retries >= HUSB238_CONN_MAX_RETRIES)
+				{
+					// Die Anfrage hat den Baustein nicht erreicht
+					enter_state(HUSB238_CONN_ERROR, now_us);
+				}
+			}
+		}
+		else
+		{
+			uint8_t response = (status1 >> 3) & 0x07;
+			if(status_ok && response != request_response)
+			{
+				response_changed = true;
+			}
+			if(status_ok && response == RESPONE_SUCCESS && husb238_decodePDSrcVoltage(status0) == requested_pd)
+			{
+				enter_contracted(now_us, status_ok, status0);
+			}
+			else if((status_ok && response_changed && response != NO_RESPONSE && response != RESPONE_SUCCESS) ||
+					(now_us - state_since_us) >= HUSB238_CONN_CONTRACT_TIMEOUT_US)
+			{
+				negotiating = false;
+				if(++retries >= HUSB238_CONN_MAX_RETRIES)
+				{
+					enter_state(HUSB238_CONN_ERROR, now_us);
+				}
+			}
+		}
+	}
+
+	if(prev_state == HUSB238_CONN_CONTRACTED && state == HUSB238_CONN_CONTRACTED && status_ok)
+	{
+		uint8_t voltage = husb238_decodePDSrcVoltage(status0);
+		if(contract_voltage == 0xFF)
+		{
+			contract_voltage = voltage;
+		}
+		else if(voltage != contract_voltage)
+		{
+			enter_state(HUSB238_CONN_CAPS_KNOWN, now_us);
+		}
+	}
+
+	if(state == HUSB238_CONN_ERROR && (now_us - state_since_us) >= HUSB238_CONN_ERROR_BACKOFF_US)
+	{
+		enter_state(HUSB238_CONN_ATTACHED, now_us);
+	}
+
+	return state;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the current connection state.
+ */
+/**************************************************************************/
+uint8_t husb238_conn_getState()
+{
+	return state;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the number of profiles found by the last enumeration, 0 while detached.
+ */
+/**************************************************************************/
+uint8_t husb238_conn_getProfileCount()
+{
+	return profile_cnt;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the time from the last replug to the restored contract.
+ *
+ * @return uint32_t
+ *         The time in microseconds from the first attach edge seen after the last
+ *         debounced detach, including bouncing and the debounce time, or 0 if no
+ *         contract has been restored yet.
+ */
+/**************************************************************************/
+uint32_t husb238_conn_getRestoreTime()
+{
+	return restore_time_us;
+}
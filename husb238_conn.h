@@ -0,0 +1,34 @@
+#ifndef HUSB238_CONN_H
+#define HUSB238_CONN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "husb238.h"
+
+#define HUSB238_CONN_DETACHED		0	///< No charger attached
+#define HUSB238_CONN_ATTACHED		1	///< Charger attached (debounced), capabilities not read yet
+#define HUSB238_CONN_CAPS_KNOWN		2	///< Capabilities read, requested profile not contracted yet
+#define HUSB238_CONN_CONTRACTED		3	///< Requested profile (or default 5V) is contracted
+#define HUSB238_CONN_ERROR			4	///< Enumeration or negotiation failed, waiting for retry
+
+#ifndef HUSB238_CONN_MAX_RETRIES
+#define HUSB238_CONN_MAX_RETRIES		3			///< Attempts per enumeration or negotiation
+#endif
+
+#ifndef HUSB238_CONN_CONTRACT_TIMEOUT_US
+#define HUSB238_CONN_CONTRACT_TIMEOUT_US	500000	///< Time to wait for a requested contract
+#endif
+
+#ifndef HUSB238_CONN_ERROR_BACKOFF_US
+#define HUSB238_CONN_ERROR_BACKOFF_US	1000000		///< Time in the error state before a new attempt
+#endif
+
+// Funktionen der Verbindungs-Zustandsmaschine
+void husb238_conn_init(uint32_t debounce_us);
+void husb238_conn_request(uint8_t pd_src);
+uint8_t husb238_conn_poll(uint32_t now_us);
+uint8_t husb238_conn_getState();
+uint8_t husb238_conn_getProfileCount();
+uint32_t husb238_conn_getRestoreTime();
+
+#endif // HUSB238_CONN_H
@@ -0,0 +1,597 @@
+#include "husb238_queue.h"
+#include "pico/critical_section.h"
+
+// Struktur für ein Kommando in der Warteschlange
+typedef struct {
+	bool used;				///< Slot is occupied
+	uint8_t prio;			///< Priority class (HUSB238_PRIO_*)
+	uint8_t op;				///< HUSB238_CMD_READ or HUSB238_CMD_WRITE
+	uint8_t reg;			///< Register address
+	uint8_t value;			///< Value to write (unused for reads)
+	uint32_t seq;			///< Enqueue order, used for FIFO within a class
+	uint32_t enqueued_us;	///< Timestamp of enqueue in microseconds
+} QueueCommand;
+
+static QueueCommand queue[HUSB238_QUEUE_SIZE];	///< Statically allocated command slots
+static critical_section_t queue_lock;			///< Protects the slots against both cores and interrupts
+static uint32_t next_seq = 0;					///< Sequence number for the next command
+
+static uint8_t reg_shadow[HUSB238_NUM_REGISTERS];	///< Last value read from each register
+static bool reg_valid[HUSB238_NUM_REGISTERS];		///< Shadow holds a successfully read value
+
+static uint32_t max_latency_us[HUSB238_PRIO_COUNT];	///< Worst enqueue-to-completion time per class
+static uint32_t merged_cnt = 0;						///< Reads merged into a pending read
+static uint32_t dropped_cnt = 0;					///< Commands rejected, evicted or flushed
+
+/**************************************************************************/
+/**
+ * @brief Returns `true` if command `a` has to be executed before command `b`.
+ *
+ * @details Commands are ordered by priority class first and by enqueue order
+ * within a class. The sequence comparison is wrap-around safe.
+ */
+/**************************************************************************/
+static bool runs_before(const QueueCommand *a, const QueueCommand *b)
+{
+	if(a->prio != b->prio)
+	{
+		return a->prio < b->prio;
+	}
+	return (int32_t)(a->seq - b->seq) < 0;
+}
+
+/**************************************************************************/
+/**
+ * @brief Finds a slot for a new command of the given priority.
+ *
+ * @param prio Priority class of the new command.
+ *
+ * @return QueueCommand*
+ *         A free slot, or `NULL` if the queue is full and no lower priority
+ *         command could be evicted.
+ *
+ * @details If every slot is in use, the youngest command of the lowest priority
+ * class below `prio` is evicted. This keeps a burst of telemetry polls from
+ * locking out a reset or a profile drop. Must be called with `queue_lock` held.
+ */
+/**************************************************************************/
+static QueueCommand *alloc_slot(uint8_t prio)
+{
+	QueueCommand *victim = NULL;
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+	{
+		if(!queue[i].used)
+		{
+			return &queue[i];
+		}
+		if(queue[i].prio > prio && (victim == NULL || runs_before(victim, &queue[i])))
+		{
+			victim = &queue[i];
+		}
+	}
+	if(victim != NULL)
+	{
+		dropped_cnt++;
+	}
+	return victim;
+}
+
+/**************************************************************************/
+/**
+ * @brief Discards all pending commands of the negotiation class.
+ *
+ * @details Called before a reset or profile drop is queued, so that an older
+ * profile request cannot undo the safety action once it has executed.
+ * Must be called with `queue_lock` held.
+ */
+/**************************************************************************/
+static void flush_negotiation(void)
+{
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+	{
+		if(queue[i].used && queue[i].prio == HUSB238_PRIO_NEGOTIATION)
+		{
+			queue[i].used = false;
+			dropped_cnt++;
+		}
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns `true` if a queued write to the register of `read` runs after `read`.
+ *
+ * @details A read that runs before such a write would return the value from before
+ * the write, so it must not be reused for a newer read. Must be called with
+ * `queue_lock` held.
+ */
+/**************************************************************************/
+static bool write_follows(const QueueCommand *read)
+{
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+	{
+		if(queue[i].used && queue[i].op == HUSB238_CMD_WRITE && queue[i].reg == read->reg &&
+			runs_before(read, &queue[i]))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**************************************************************************/
+/**
+ * @brief Initializes the command queue.
+ *
+ * @details Claims the spin lock that protects the queue and discards all pending
+ * commands. Call this function once, before the queue is used from any context.
+ * Until then all queue functions fail.
+ *
+ * Example:
+ * ```
+ * husb238_init(i2c_instance);
+ * husb238_queue_init();
+ * ```
+ */
+/**************************************************************************/
+void husb238_queue_init()
+{
+	if(!critical_section_is_initialized(&queue_lock))
+	{
+		critical_section_init(&queue_lock);
+	}
+	husb238_queue_clear();
+}
+
+/**************************************************************************/
+/**
+ * @brief Queues a register read.
+ *
+ * @param reg The register address to read from.
+ * @param prio The priority class (`HUSB238_PRIO_SAFETY`, `HUSB238_PRIO_NEGOTIATION`
+ *             or `HUSB238_PRIO_TELEMETRY`).
+ *
+ * @return bool
+ *         `true` if the read was queued or merged into a pending read,
+ *         `false` if the arguments are invalid or the queue is full.
+ *
+ * @details If a read of the same register is already pending, no new command is
+ * queued. The pending read is promoted to `prio` if that is more urgent. A pending
+ * read is only reused if it still runs after every queued write to `reg`, so merging
+ * never returns an older value than a separate read of the same priority would. The
+ * result is stored in a shadow copy that can be fetched with
+ * `husb238_queue_getRegister()` after `husb238_queue_service()` has run.
+ *
+ * Example:
+ * ```
+ * husb238_queue_read(HUSB238_PD_STATUS1, HUSB238_PRIO_TELEMETRY);
+ * ```
+ */
+/**************************************************************************/
+bool husb238_queue_read(uint8_t reg, uint8_t prio)
+{
+	if(reg >= HUSB238_NUM_REGISTERS || prio >= HUSB238_PRIO_COUNT)
+	{
+		return false;
+	}
+
+	if(!critical_section_is_initialized(&queue_lock))
+	{
+		return false;
+	}
+
+	critical_section_enter_blocking(&queue_lock);
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+	{
+		if(queue[i].used && queue[i].op == HUSB238_CMD_READ && queue[i].reg == reg)
+		{
+			QueueCommand merged = queue[i];
+			if(prio < merged.prio)
+			{
+				merged.prio = prio;
+			}
+			if(!write_follows(&merged))
+			{
+				queue[i] = merged;
+				merged_cnt++;
+				critical_section_exit(&queue_lock);
+				return true;
+			}
+		}
+	}
+
+	QueueCommand *cmd = alloc_slot(prio);
+	if(cmd == NULL)
+	{
+		dropped_cnt++;
+		critical_section_exit(&queue_lock);
+		return false;
+	}
+	*cmd = (QueueCommand){true, prio, HUSB238_CMD_READ, reg, 0, next_seq++, time_us_32()};
+	critical_section_exit(&queue_lock);
+	return true;
+}
+
+/**************************************************************************/
+/**
+ * @brief Queues a register write.
+ *
+ * @param reg The register address to write to.
+ * @param value The value to write to the register.
+ * @param prio The priority class of the write.
+ *
+ * @return bool
+ *         `true` if the write was queued, `false` if the arguments are invalid
+ *         or the queue is full.
+ *
+ * @details Writes are never merged, since the order of `SRC_PDO` and
+ * `GO_COMMAND` writes is significant.
+ */
+/**************************************************************************/
+bool husb238_queue_write(uint8_t reg, uint8_t value, uint8_t prio)
+{
+	if(reg >= HUSB238_NUM_REGISTERS || prio >= HUSB238_PRIO_COUNT)
+	{
+		return false;
+	}
+
+	if(!critical_section_is_initialized(&queue_lock))
+	{
+		return false;
+	}
+
+	critical_section_enter_blocking(&queue_lock);
+	QueueCommand *cmd = alloc_slot(prio);
+	if(cmd == NULL)
+	{
+		dropped_cnt++;
+		critical_section_exit(&queue_lock);
+		return false;
+	}
+	*cmd = (QueueCommand){true, prio, HUSB238_CMD_WRITE, reg, value, next_seq++, time_us_32()};
+	critical_section_exit(&queue_lock);
+	return true;
+}
+
+/**************************************************************************/
+/**
+ * @brief Queues a safety action of one or more writes as a unit.
+ *
+ * @param regs The registers to write, in execution order.
+ * @param values The values to write.
+ * @param count The number of writes.
+ *
+ * @return bool
+ *         `true` if all writes were queued, `false` if the queue has no room for
+ *         all of them. In that case none of them is queued.
+ *
+ * @details Pending negotiation commands are discarded first. The flush, the check
+ * for enough free or evictable slots and the allocation run in one critical
+ * section, so another context can neither take a slot in between nor observe
+ * half of the action.
+ */
+/**************************************************************************/
+static bool queue_safety_writes(const uint8_t *regs, const uint8_t *values, uint8_t count)
+{
+	if(!critical_section_is_initialized(&queue_lock))
+	{
+		return false;
+	}
+	critical_section_enter_blocking(&queue_lock);
+	flush_negotiation();
+	uint8_t available = 0;
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+	{
+		if(!queue[i].used || queue[i].prio > HUSB238_PRIO_SAFETY)
+		{
+			available++;
+		}
+	}
+	if(available < count)
+	{
+		dropped_cnt += count;
+		critical_section_exit(&queue_lock);
+		return false;
+	}
+	uint32_t now_us = time_us_32();
+	for(uint8_t i = 0; i < count; i++)
+	{
+		QueueCommand *cmd = alloc_slot(HUSB238_PRIO_SAFETY);
+		*cmd = (QueueCommand){true, HUSB238_PRIO_SAFETY, HUSB238_CMD_WRITE, regs[i], values[i], next_seq++, now_us};
+	}
+	critical_section_exit(&queue_lock);
+	return true;
+}
+
+/**************************************************************************/
+/**
+ * @brief Queues a reset of the HUSB238 with safety priority.
+ *
+ * @return bool
+ *         `true` if the reset was queued, `false` otherwise.
+ *
+ * @details Pending negotiation commands are discarded first. See `husb238_reset()`.
+ */
+/**************************************************************************/
+bool husb238_queue_reset()
+{
+	const uint8_t regs[1] = {HUSB238_GO_COMMAND};
+	const uint8_t values[1] = {0b10000};
+	return queue_safety_writes(regs, values, 1);
+}
+
+/**************************************************************************/
+/**
+ * @brief Queues a drop to the 5V profile with safety priority.
+ *
+ * @return bool
+ *         `true` if both the selection and the request were queued, `false` otherwise.
+ *
+ * @details Pending negotiation commands are discarded first, then `PD_SRC_5V` is
+ * selected and requested in one go. Either both writes are queued or neither.
+ */
+/**************************************************************************/
+bool husb238_queue_dropPD()
+{
+	const uint8_t regs[2] = {HUSB238_SRC_PDO, HUSB238_GO_COMMAND};
+	const uint8_t values[2] = {PD_SRC_5V << 4, 0b00001};
+	return queue_safety_writes(regs, values, 2);
+}
+
+/**************************************************************************/
+/**
+ * @brief Queues a PD selection with negotiation priority. See `husb2238_selectPD()`.
+ */
+/**************************************************************************/
+bool husb238_queue_selectPD(uint8_t pd_src)
+{
+	return husb238_queue_write(HUSB238_SRC_PDO, (pd_src & 0x0F) << 4, HUSB238_PRIO_NEGOTIATION);
+}
+
+/**************************************************************************/
+/**
+ * @brief Queues a PD request with negotiation priority. See `husb238_requestPD()`.
+ */
+/**************************************************************************/
+bool husb238_queue_requestPD()
+{
+	return husb238_queue_write(HUSB238_GO_COMMAND, 0b00001, HUSB238_PRIO_NEGOTIATION);
+}
+
+/**************************************************************************/
+/**
+ * @brief Queues a status poll of a register with telemetry priority.
+ */
+/**************************************************************************/
+bool husb238_queue_poll(uint8_t reg)
+{
+	return husb238_queue_read(reg, HUSB238_PRIO_TELEMETRY);
+}
+
+/**************************************************************************/
+/**
+ * @brief Executes queued commands on the bus.
+ *
+ * @param max_cmds The maximum number of commands to execute, or 0 to drain the queue.
+ *
+ * @return uint8_t
+ *         The number of commands that were executed.
+ *
+ * @details This function must only be called from the one context that owns the
+ * I2C bus. The queue may be filled from any context on either core, including
+ * interrupts. On each
+ * step the most urgent command is taken: safety before negotiation before telemetry,
+ * FIFO within a class. A safety command therefore waits at most for the transaction
+ * that is currently in flight plus the safety commands queued before it. The time
+ * from enqueue to completion is tracked per class, see `husb238_queue_getMaxLatency()`.
+ *
+ * Usage:
+ * - Call this function periodically from the main loop, e.g. with `max_cmds = 1`
+ *   to bound the time spent per iteration.
+ *
+ * Example:
+ * ```
+ * while (true) {
+ *     husb238_queue_service(1);
+ *     // other work
+ * }
+ * ```
+ */
+/**************************************************************************/
+uint8_t husb238_queue_service(uint8_t max_cmds)
+{
+	uint8_t executed = 0;
+	if(!critical_section_is_initialized(&queue_lock))
+	{
+		return 0;
+	}
+	while(max_cmds == 0 || executed < max_cmds)
+	{
+		critical_section_enter_blocking(&queue_lock);
+		QueueCommand *next = NULL;
+		for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+		{
+			if(queue[i].used && (next == NULL || runs_before(&queue[i], next)))
+			{
+				next = &queue[i];
+			}
+		}
+		if(next == NULL)
+		{
+			critical_section_exit(&queue_lock);
+			break;
+		}
+		QueueCommand cmd = *next;
+		next->used = false;
+		critical_section_exit(&queue_lock);
+
+		if(cmd.op == HUSB238_CMD_READ)
+		{
+			uint8_t value = 0;
+			if(husb238_read_register(cmd.reg, &value))
+			{
+				reg_shadow[cmd.reg] = value;
+				reg_valid[cmd.reg] = true;
+			}
+			else
+			{
+				reg_valid[cmd.reg] = false;
+			}
+		}
+		else
+		{
+			reg_valid[cmd.reg] = false;
+			husb238_write_register(cmd.reg, cmd.value);
+		}
+
+		uint32_t latency = time_us_32() - cmd.enqueued_us;
+		if(latency > max_latency_us[cmd.prio])
+		{
+			max_latency_us[cmd.prio] = latency;
+		}
+		executed++;
+	}
+	return executed;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the number of commands waiting in the queue.
+ */
+/**************************************************************************/
+uint8_t husb238_queue_pending()
+{
+	uint8_t cnt = 0;
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+	{
+		if(queue[i].used)
+		{
+			cnt++;
+		}
+	}
+	return cnt;
+}
+
+/**************************************************************************/
+/**
+ * @brief Discards all pending commands and invalidates the register shadow.
+ */
+/**************************************************************************/
+void husb238_queue_clear()
+{
+	if(!critical_section_is_initialized(&queue_lock))
+	{
+		return;
+	}
+	critical_section_enter_blocking(&queue_lock);
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+	{
+		queue[i].used = false;
+	}
+	for(uint8_t i = 0; i < HUSB238_NUM_REGISTERS; i++)
+	{
+		reg_valid[i] = false;
+	}
+	critical_section_exit(&queue_lock);
+}
+
+/**************************************************************************/
+/**
+ * @brief Retrieves the last value read from a register by the queue.
+ *
+ * @param reg The register address.
+ * @param value Pointer to a variable where the register value will be stored.
+ *
+ * @return bool
+ *         `true` if the last queued read of `reg` was successful,
+ *         `false` if the register was never read or the last read failed.
+ *
+ * Example:
+ * ```
+ * uint8_t status = 0;
+ * if (husb238_queue_getRegister(HUSB238_PD_STATUS1, &status)) {
+ *     bool attached = (status >> 6) & 0x01;
+ * }
+ * ```
+ */
+/**************************************************************************/
+bool husb238_queue_getRegister(uint8_t reg, uint8_t *value)
+{
+	if(reg >= HUSB238_NUM_REGISTERS || !reg_valid[reg])
+	{
+		return false;
+	}
+	*value = reg_shadow[reg];
+	return true;
+}
+
+/**************************************************************************/
+/**
+ * @brief Checks if a read of the given register is still waiting in the queue.
+ */
+/**************************************************************************/
+bool husb238_queue_isReadPending(uint8_t reg)
+{
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE; i++)
+	{
+		if(queue[i].used && queue[i].op == HUSB238_CMD_READ && queue[i].reg == reg)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the worst observed enqueue-to-completion time of a priority class.
+ *
+ * @param prio The priority class.
+ *
+ * @return uint32_t
+ *         The worst latency in microseconds since the last `husb238_queue_resetStats()`.
+ */
+/**************************************************************************/
+uint32_t husb238_queue_getMaxLatency(uint8_t prio)
+{
+	if(prio >= HUSB238_PRIO_COUNT)
+	{
+		return 0;
+	}
+	return max_latency_us[prio];
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the number of reads that were merged into a pending read.
+ */
+/**************************************************************************/
+uint32_t husb238_queue_getMerged()
+{
+	return merged_cnt;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the number of commands that were rejected, evicted or flushed.
+ */
+/**************************************************************************/
+uint32_t husb238_queue_getDropped()
+{
+	return dropped_cnt;
+}
+
+/**************************************************************************/
+/**
+ * @brief Clears the latency, merge and drop statistics.
+ */
+/**************************************************************************/
+void husb238_queue_resetStats()
+{
+	for(uint8_t i = 0; i < HUSB238_PRIO_COUNT; i++)
+	{
+		max_latency_us[i] = 0;
+	}
+	merged_cnt = 0;
+	dropped_cnt = 0;
+}
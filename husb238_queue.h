@@ -0,0 +1,47 @@
+#ifndef HUSB238_QUEUE_H
+#define HUSB238_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "husb238.h"
+
+#ifndef HUSB238_QUEUE_SIZE
+#define HUSB238_QUEUE_SIZE		16	///< Number of statically allocated command slots
+#endif
+
+#define HUSB238_PRIO_SAFETY			0	///< Reset, profile drop (highest priority)
+#define HUSB238_PRIO_NEGOTIATION	1	///< Profile selection and PD requests
+#define HUSB238_PRIO_TELEMETRY		2	///< Status polls (lowest priority)
+#define HUSB238_PRIO_COUNT			3	///< Number of priority classes
+
+#define HUSB238_CMD_READ		0	///< Read a register into the shadow copy
+#define HUSB238_CMD_WRITE		1	///< Write a value to a register
+
+#define HUSB238_NUM_REGISTERS	(HUSB238_GO_COMMAND + 1)	///< Number of addressable registers
+
+// Funktion zur Initialisierung
+void husb238_queue_init();
+
+// Funktionen zum Einreihen von Kommandos
+bool husb238_queue_read(uint8_t reg, uint8_t prio);
+bool husb238_queue_write(uint8_t reg, uint8_t value, uint8_t prio);
+bool husb238_queue_reset();
+bool husb238_queue_dropPD();
+bool husb238_queue_selectPD(uint8_t pd_src);
+bool husb238_queue_requestPD();
+bool husb238_queue_poll(uint8_t reg);
+
+// Funktionen für den Bus-Besitzer
+uint8_t husb238_queue_service(uint8_t max_cmds);
+uint8_t husb238_queue_pending();
+void husb238_queue_clear();
+
+// Ergebnisse und Statistik
+bool husb238_queue_getRegister(uint8_t reg, uint8_t *value);
+bool husb238_queue_isReadPending(uint8_t reg);
+uint32_t husb238_queue_getMaxLatency(uint8_t prio);
+uint32_t husb238_queue_getMerged();
+uint32_t husb238_queue_getDropped();
+void husb238_queue_resetStats();
+
+#endif // HUSB238_QUEUE_H
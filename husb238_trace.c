@@ -0,0 +1,319 @@
+#include "husb238_trace.h"
+
+_Static_assert(sizeof(HUSB238TraceRecord) == 8, "trace records are stored as raw 8 byte binary");
+
+static bool record_write(uint8_t reg, uint8_t value, void *ctx);
+static bool record_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx);
+static bool replay_write(uint8_t reg, uint8_t value, void *ctx);
+static bool replay_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx);
+
+static const HUSB238Transport record_transport = {record_write, record_read, NULL};	///< Recording wrapper
+static const HUSB238Transport replay_transport = {replay_write, replay_read, NULL};	///< Replay of a trace
+
+// Aufzeichnung
+static const HUSB238Transport *record_inner = NULL;	///< Transport wrapped by the recorder
+static HUSB238TraceRecord *record_buf = NULL;		///< Caller provided record buffer
+static uint32_t record_capacity = 0;				///< Number of records fitting into record_buf
+static uint32_t record_cnt = 0;						///< Number of records written
+static bool record_overflow = false;				///< Records were lost because the buffer was full
+static uint64_t record_start_us = 0;				///< Start time of the recording
+
+// Wiedergabe
+static const HUSB238Transport *replay_prev = NULL;	///< Transport active before the replay
+static const HUSB238TraceRecord *replay_buf = NULL;	///< Trace being replayed
+static uint32_t replay_cnt = 0;						///< Number of records in replay_buf
+static uint32_t replay_pos = 0;						///< Next record to replay
+static uint16_t replay_scale = 0;					///< Time scale in percent of the recorded timing
+static uint64_t replay_start_us = 0;				///< Start time of the replay
+static uint32_t replay_divergence = HUSB238_TRACE_NO_DIVERGENCE;	///< First mismatching record
+
+static uint32_t transactions = 0;	///< Transactions seen by the recorder or the replay
+
+/**************************************************************************/
+/**
+ * @brief Appends one record to the recording buffer.
+ */
+/**************************************************************************/
+static void append_record(uint8_t reg, uint8_t flags, uint8_t data, uint64_t now_us)
+{
+	if(record_cnt >= record_capacity)
+	{
+		record_overflow = true;
+		return;
+	}
+	record_buf[record_cnt++] = (HUSB238TraceRecord){(uint32_t)(now_us - record_start_us), reg, flags, data, 0};
+}
+
+/**************************************************************************/
+/**
+ * @brief Recording `write` function: forwards to the wrapped transport and logs the result.
+ */
+/**************************************************************************/
+static bool record_write(uint8_t reg, uint8_t value, void *ctx)
+{
+	bool ok = record_inner->write(reg, value, record_inner->ctx);
+	transactions++;
+	append_record(reg, HUSB238_TRACE_WRITE | (ok ? HUSB238_TRACE_OK : 0), value, time_us_64());
+	return ok;
+}
+
+/**************************************************************************/
+/**
+ * @brief Recording `read` function: forwards to the wrapped transport and logs one
+ * record per register read.
+ */
+/**************************************************************************/
+static bool record_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx)
+{
+	bool ok = record_inner->read(reg, value, len, record_inner->ctx);
+	uint64_t now_us = time_us_64();
+	transactions++;
+	for(uint8_t i = 0; i < len; i++)
+	{
+		append_record(reg + i, ok ? HUSB238_TRACE_OK : 0, ok ? value[i] : 0, now_us);
+	}
+	return ok;
+}
+
+/**************************************************************************/
+/**
+ * @brief Waits until the scaled timestamp of a replayed record is reached.
+ */
+/**************************************************************************/
+static void replay_wait(const HUSB238TraceRecord *rec)
+{
+	if(replay_scale == HUSB238_TRACE_NO_WAIT)
+	{
+		return;
+	}
+	uint64_t target = replay_start_us + (uint64_t)rec->timestamp_us * replay_scale / 100;
+	uint64_t now = time_us_64();
+	if(target > now)
+	{
+		sleep_us(target - now);
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Records the first position where the driver left the replayed trace.
+ */
+/**************************************************************************/
+static bool diverge(uint32_t pos)
+{
+	if(replay_divergence == HUSB238_TRACE_NO_DIVERGENCE)
+	{
+		replay_divergence = pos;
+	}
+	return false;
+}
+
+/**************************************************************************/
+/**
+ * @brief Replay `write` function: checks the write against the next record of the trace.
+ */
+/**************************************************************************/
+static bool replay_write(uint8_t reg, uint8_t value, void *ctx)
+{
+	transactions++;
+	if(replay_pos >= replay_cnt)
+	{
+		return diverge(replay_pos);
+	}
+	const HUSB238TraceRecord *rec = &replay_buf[replay_pos];
+	if(!(rec->flags & HUSB238_TRACE_WRITE) || rec->reg != reg || rec->data != value)
+	{
+		return diverge(replay_pos);
+	}
+	replay_pos++;
+	replay_wait(rec);
+	return rec->flags & HUSB238_TRACE_OK;
+}
+
+/**************************************************************************/
+/**
+ * @brief Replay `read` function: returns the recorded data of the next `len` records.
+ */
+/**************************************************************************/
+static bool replay_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx)
+{
+	transactions++;
+	if(replay_pos + len > replay_cnt)
+	{
+		return diverge(replay_pos);
+	}
+	bool ok = true;
+	for(uint8_t i = 0; i < len; i++)
+	{
+		const HUSB238TraceRecord *rec = &replay_buf[replay_pos + i];
+		if((rec->flags & HUSB238_TRACE_WRITE) || rec->reg != (uint8_t)(reg + i))
+		{
+			return diverge(replay_pos + i);
+		}
+	}
+	for(uint8_t i = 0; i < len; i++)
+	{
+		const HUSB238TraceRecord *rec = &replay_buf[replay_pos + i];
+		value[i] = rec->data;
+		ok = ok && (rec->flags & HUSB238_TRACE_OK);
+	}
+	replay_pos += len;
+	replay_wait(&replay_buf[replay_pos - 1]);
+	return ok;
+}
+
+/**************************************************************************/
+/**
+ * @brief Starts recording all register access into a caller provided buffer.
+ *
+ * @param buffer The buffer that receives the trace records.
+ * @param capacity The number of records fitting into `buffer`.
+ *
+ * @details The recorder wraps the transport that is currently active, so the bus
+ * traffic is unchanged. Each register written or read produces one 8 byte record
+ * with the time since the start of the recording, the register, the direction, the
+ * data and whether the transaction was successful. A burst read produces one record
+ * per register. Once the buffer is full, further records are dropped and
+ * `husb238_trace_isOverflowed()` returns `true`.
+ *
+ * The buffer can be dumped as raw binary, e.g. over USB, and fed back with
+ * `husb238_trace_startReplay()`. Calling this function while a recording is running
+ * restarts the recording into the new buffer and keeps the wrapped transport.
+ *
+ * Example:
+ * ```
+ * static HUSB238TraceRecord trace[512];
+ *
+ * husb238_trace_startRecording(trace, 512);
+ * husb238_init(i2c0);
+ * uint32_t cnt = husb238_trace_stopRecording();
+ * fwrite(trace, sizeof(HUSB238TraceRecord), cnt, stdout);
+ * ```
+ */
+/**************************************************************************/
+void husb238_trace_startRecording(HUSB238TraceRecord *buffer, uint32_t capacity)
+{
+	record_buf = buffer;
+	record_capacity = buffer != NULL ? capacity : 0;
+	record_cnt = 0;
+	record_overflow = false;
+	transactions = 0;
+	record_start_us = time_us_64();
+	if(husb238_getTransport() != &record_transport)
+	{
+		record_inner = husb238_getTransport();
+		husb238_setTransport(&record_transport);
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Stops the recording and restores the wrapped transport.
+ *
+ * @return uint32_t
+ *         The number of records stored in the buffer.
+ */
+/**************************************************************************/
+uint32_t husb238_trace_stopRecording()
+{
+	if(husb238_getTransport() == &record_transport)
+	{
+		husb238_setTransport(record_inner);
+	}
+	return record_cnt;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns `true` if records were lost because the recording buffer was full.
+ */
+/**************************************************************************/
+bool husb238_trace_isOverflowed()
+{
+	return record_overflow;
+}
+
+/**************************************************************************/
+/**
+ * @brief Replaces the bus by a recorded trace.
+ *
+ * @param records The trace to replay.
+ * @param count The number of records in the trace.
+ * @param time_scale The replay speed in percent of the recorded timing:
+ *                   `HUSB238_TRACE_REALTIME` (100) preserves the timing, 50 replays
+ *                   twice as fast, `HUSB238_TRACE_NO_WAIT` (0) does not wait at all.
+ *
+ * @details Every register access of the driver is matched against the next record.
+ * Reads return the recorded data and status, writes must match register and value
+ * of the recorded write. If the driver leaves the trace, the access fails and the
+ * position is reported by `husb238_trace_getDivergence()`. The replay does not touch
+ * the I2C hardware, so field captures can be replayed by the host build in `test/`
+ * as deterministic regression tests, see `test/test_trace.c`. Comparing
+ * `husb238_trace_getTransactions()` with the recorded transaction count shows if a
+ * driver change needs more or fewer bus transactions. Calling this function while a
+ * replay is running starts the new trace and keeps the transport to restore.
+ *
+ * Example:
+ * ```
+ * husb238_trace_startReplay(trace, cnt, HUSB238_TRACE_NO_WAIT);
+ * husb238_init(NULL);
+ * if (husb238_trace_getDivergence() != HUSB238_TRACE_NO_DIVERGENCE) {
+ *     // driver behaves differently than during the capture
+ * }
+ * husb238_trace_stopReplay();
+ * ```
+ */
+/**************************************************************************/
+void husb238_trace_startReplay(const HUSB238TraceRecord *records, uint32_t count, uint16_t time_scale)
+{
+	replay_buf = records;
+	replay_cnt = records != NULL ? count : 0;
+	replay_pos = 0;
+	replay_scale = time_scale;
+	replay_divergence = HUSB238_TRACE_NO_DIVERGENCE;
+	transactions = 0;
+	replay_start_us = time_us_64();
+	if(husb238_getTransport() != &replay_transport)
+	{
+		replay_prev = husb238_getTransport();
+		husb238_setTransport(&replay_transport);
+	}
+}
+
+/**************************************************************************/
+/**
+ * @brief Stops the replay and restores the transport that was active before.
+ *
+ * @return uint32_t
+ *         The number of records consumed by the driver.
+ */
+/**************************************************************************/
+uint32_t husb238_trace_stopReplay()
+{
+	if(husb238_getTransport() == &replay_transport)
+	{
+		husb238_setTransport(replay_prev);
+	}
+	return replay_pos;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the index of the first record the driver did not match during replay,
+ * or `HUSB238_TRACE_NO_DIVERGENCE`.
+ */
+/**************************************************************************/
+uint32_t husb238_trace_getDivergence()
+{
+	return replay_divergence;
+}
+
+/**************************************************************************/
+/**
+ * @brief Returns the number of bus transactions since the last start of a recording or replay.
+ */
+/**************************************************************************/
+uint32_t husb238_trace_getTransactions()
+{
+	return transactions;
+}
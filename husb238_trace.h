@@ -0,0 +1,38 @@
+#ifndef HUSB238_TRACE_H
+#define HUSB238_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "husb238.h"
+
+#define HUSB238_TRACE_WRITE		0x01	///< Flag: transaction was a register write
+#define HUSB238_TRACE_OK		0x02	///< Flag: transaction was successful
+
+#define HUSB238_TRACE_NO_DIVERGENCE		0xFFFFFFFF	///< Replay matched the trace so far
+
+#define HUSB238_TRACE_REALTIME	100		///< Replay time scale preserving the recorded timing
+#define HUSB238_TRACE_NO_WAIT	0		///< Replay time scale without any waiting
+
+// Struktur für einen Eintrag im Bus-Trace (8 Byte)
+typedef struct {
+	uint32_t timestamp_us;	///< Time since start of recording in microseconds
+	uint8_t reg;			///< Register address
+	uint8_t flags;			///< HUSB238_TRACE_WRITE, HUSB238_TRACE_OK
+	uint8_t data;			///< Value written or read
+	uint8_t reserved;		///< Always 0
+} HUSB238TraceRecord;
+
+// Funktionen zur Aufzeichnung
+void husb238_trace_startRecording(HUSB238TraceRecord *buffer, uint32_t capacity);
+uint32_t husb238_trace_stopRecording();
+bool husb238_trace_isOverflowed();
+
+// Funktionen zur Wiedergabe
+void husb238_trace_startReplay(const HUSB238TraceRecord *records, uint32_t count, uint16_t time_scale);
+uint32_t husb238_trace_stopReplay();
+uint32_t husb238_trace_getDivergence();
+
+// Statistik
+uint32_t husb238_trace_getTransactions();
+
+#endif // HUSB238_TRACE_H
@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include "husb238_conn.h"
+#include "sim_husb238.h"
+#include "host_pico.h"
+
+// Benchmark der Verbindungs-Zustandsmaschine: Zeit vom Wiedereinstecken bis zum
+// wiederhergestellten Vertrag bei prellendem Kabel, abgelehnten Requests,
+// Busfehlern und einem Vertragsverlust ohne Abstecken.
+
+#define POLL_US				1000	///< Poll period of the application
+#define DEBOUNCE_US			20000	///< Debounce time of the state machine
+#define TRANSACTION_US		270		///< Simulated bus time per transaction
+#define CONTRACT_DELAY_US	5000	///< Simulated time from request to contract
+#define REPLUGS				1000	///< Replugs per scenario
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); return 1; } } while(0)
+
+static uint32_t rng = 4711;	///< State of the pseudo random generator
+static bool saw_error = false;	///< The state machine entered HUSB238_CONN_ERROR
+
+static uint32_t next_random(void)
+{
+	rng = rng * 1103515245 + 12345;
+	return rng >> 16;
+}
+
+/// Polls for the given time
+static void run(uint32_t duration_us)
+{
+	uint64_t end = time_us_64() + duration_us;
+	while(time_us_64() < end)
+	{
+		host_advance_us(POLL_US);
+		if(husb238_conn_poll(time_us_32()) == HUSB238_CONN_ERROR)
+		{
+			saw_error = true;
+		}
+	}
+}
+
+/// Polls until the contract is restored, returns false on timeout
+static bool run_until_contracted(void)
+{
+	for(uint32_t i = 0; i < 2000; i++)
+	{
+		host_advance_us(POLL_US);
+		uint8_t state = husb238_conn_poll(time_us_32());
+		if(state == HUSB238_CONN_ERROR)
+		{
+			saw_error = true;
+		}
+		if(state == HUSB238_CONN_CONTRACTED)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static uint8_t fault_state = HUSB238_CONN_DETACHED;	///< State in which the bus faults are injected
+static uint32_t fault_cnt = 0;							///< Bus faults still to inject
+
+/// Runs in the middle of every transaction: injects the faults once the state is reached
+static void transaction_hook(void)
+{
+	if(fault_cnt > 0 && husb238_conn_getState() == fault_state)
+	{
+		sim_failNext(fault_cnt);
+		fault_cnt = 0;
+	}
+}
+
+/// Toggles the attach bit a random number of times with random bounce lengths,
+/// returns the time of the first edge to end_attached
+static uint64_t flap(uint8_t max_bounces, bool end_attached)
+{
+	uint8_t bounces = max_bounces > 0 ? next_random() % (max_bounces + 1) : 0;
+	uint64_t first_edge_us = time_us_64();
+	for(uint8_t i = 0; i < bounces; i++)
+	{
+		sim_setAttached(i % 2 == 0 ? end_attached : !end_attached);
+		run(1000 + next_random() % (DEBOUNCE_US - 2000));
+	}
+	sim_setAttached(end_attached);
+	return first_edge_us;
+}
+
+/// Runs REPLUGS replugs and reports the restore time. Faults are injected once the
+/// state machine is in `state_for_faults`, i.e. after the debounced attach.
+static int scenario(const char *name, uint8_t max_bounces, uint32_t rejects, uint8_t state_for_faults,
+	uint32_t faults, uint32_t extra_us)
+{
+	uint32_t min_us = UINT32_MAX;
+	uint32_t max_us = 0;
+	uint64_t sum_us = 0;
+	uint32_t max_settle_us = 0;
+	uint32_t transactions = 0;
+	uint32_t requests = sim_getRequests();
+	saw_error = false;
+
+	for(uint32_t i = 0; i < REPLUGS; i++)
+	{
+		flap(max_bounces, false);
+		run(2 * DEBOUNCE_US);
+		CHECK(husb238_conn_getState() == HUSB238_CONN_DETACHED);
+		CHECK(!husb238_isVoltageDetected(PD_SRC_9V));
+
+		uint32_t start = sim_getTransactions();
+		sim_rejectRequests(rejects);
+		fault_state = state_for_faults;
+		fault_cnt = faults;
+		uint64_t first_edge_us = flap(max_bounces, true);
+		uint64_t settled_us = time_us_64();
+		CHECK(run_until_contracted());
+		CHECK(fault_cnt == 0);
+		transactions += sim_getTransactions() - start;
+		CHECK(husb238_getPDSrcVoltage() == PD_SRC_9V);
+
+		// Measured from the first attach edge, so the bouncing is included
+		uint32_t wall_us = time_us_64() - first_edge_us;
+		uint32_t restore_us = husb238_conn_getRestoreTime();
+		// The edge is seen by the next poll, the contract by the status read of the last one
+		CHECK(restore_us <= wall_us && restore_us + POLL_US + 2 * TRANSACTION_US >= wall_us);
+		uint32_t settle_us = time_us_64() - settled_us;
+		max_settle_us = settle_us > max_settle_us ? settle_us : max_settle_us;
+
+		sum_us += restore_us;
+		min_us = restore_us < min_us ? restore_us : min_us;
+		max_us = restore_us > max_us ? restore_us : max_us;
+	}
+	requests = sim_getRequests() - requests;
+
+	printf("%-28s restore min %6u us, avg %6u us, max %6u us, after last bounce max %6u us, "
+		"%5.1f transactions, %4.2f requests per replug\n",
+		name, min_us, (uint32_t)(sum_us / REPLUGS), max_us, max_settle_us,
+		(double)transactions / REPLUGS, (double)requests / REPLUGS);
+	CHECK(!saw_error);
+	// Debounce, enumeration and request in one poll, the contract a few polls later
+	CHECK(max_settle_us <= DEBOUNCE_US + CONTRACT_DELAY_US + 3 * POLL_US + extra_us);
+	return 0;
+}
+
+/// The charger falls back to 5V without a detach: the contract is negotiated again
+static int contract_lost(void)
+{
+	CHECK(husb238_conn_getState() == HUSB238_CONN_CONTRACTED);
+	uint32_t requests = sim_getRequests();
+	sim_setContract(PD_SRC_5V);
+	run(POLL_US);
+	CHECK(husb238_conn_getState() != HUSB238_CONN_CONTRACTED);
+	CHECK(run_until_contracted());
+	CHECK(husb238_getPDSrcVoltage() == PD_SRC_9V);
+	CHECK(sim_getRequests() == requests + 1);
+	printf("%-28s contract restored with one request\n", "contract lost");
+	return 0;
+}
+
+/// A Type-C source without PD offers no PDOs: the default 5V contract is kept, no error loop
+static int legacy_source(void)
+{
+	sim_reset();
+	sim_setTransactionTime(TRANSACTION_US);
+	husb238_conn_init(DEBOUNCE_US);
+	saw_error = false;
+
+	husb238_conn_request(PD_NOT_SELECTED);
+	sim_setAttached(true);
+	CHECK(run_until_contracted());
+	CHECK(husb238_conn_getProfileCount() == 0);
+
+	husb238_conn_request(PD_SRC_9V);
+	run(3 * HUSB238_CONN_ERROR_BACKOFF_US);
+	CHECK(!saw_error && husb238_conn_getState() == HUSB238_CONN_CAPS_KNOWN);
+	CHECK(sim_getRequests() == 0);
+	printf("%-28s 5V kept, no PD request, no error state\n", "source without PD");
+	return 0;
+}
+
+int main(void)
+{
+	sim_reset();
+	sim_setPDO(PD_SRC_5V, CURRENT_3_0_A);
+	sim_setPDO(PD_SRC_9V, CURRENT_3_0_A);
+	sim_setPDO(PD_SRC_20V, CURRENT_2_25_A);
+	sim_setTransactionTime(TRANSACTION_US);
+	sim_setContractDelay(CONTRACT_DELAY_US);
+	sim_setHook(transaction_hook);
+	husb238_setTransport(&sim_transport);
+	husb238_init(NULL);
+	husb238_conn_init(DEBOUNCE_US);
+	husb238_conn_request(PD_SRC_9V);
+
+	if(scenario("clean replug", 0, 0, HUSB238_CONN_DETACHED, 0, 0) ||
+		scenario("flapping cable", 8, 0, HUSB238_CONN_DETACHED, 0, 0) ||
+		scenario("flapping, first rejected", 8, 1, HUSB238_CONN_DETACHED, 0, CONTRACT_DELAY_US + 3 * POLL_US) ||
+		scenario("flapping, enumeration fault", 8, 0, HUSB238_CONN_ATTACHED, 2, 2 * POLL_US) ||
+		scenario("flapping, request fault", 8, 0, HUSB238_CONN_CAPS_KNOWN, 1, 2 * POLL_US) ||
+		contract_lost() ||
+		legacy_source())
+	{
+		return 1;
+	}
+	return 0;
+}
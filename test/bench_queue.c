@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "husb238_queue.h"
+#include "sim_husb238.h"
+#include "host_pico.h"
+
+// Benchmark der Kommando-Warteschlange: Status-Poll-Sturm mit zufälligen Resets
+// und Profil-Drops, die während laufender Bus-Transaktionen eingereiht werden.
+
+#define TRANSACTION_US	270			///< One register access at 100 kHz
+#define ITERATIONS		200000		///< Service steps
+#define EVENT_SPACING	8			///< Minimum transactions between two safety events
+
+static uint32_t rng = 12345;				///< State of the pseudo random generator
+static uint32_t since_event = 0;			///< Transactions since the last safety event
+static uint32_t safety_events = 0;			///< Resets and drops queued
+static uint32_t negotiation_requests = 0;	///< Profile requests queued
+
+static uint32_t next_random(void)
+{
+	rng = rng * 1103515245 + 12345;
+	return rng >> 16;
+}
+
+/// Runs in the middle of every bus transaction, like an interrupt or the other core
+static void transaction_hook(void)
+{
+	since_event++;
+	if(since_event >= EVENT_SPACING && next_random() % 40 == 0)
+	{
+		since_event = 0;
+		safety_events++;
+		if(next_random() % 2)
+		{
+			husb238_queue_reset();
+		}
+		else
+		{
+			husb238_queue_dropPD();
+		}
+	}
+}
+
+/// A read queued after a write must not be merged into a read that runs before the write
+static int check_read_after_write(void)
+{
+	husb238_queue_clear();
+	husb238_queue_poll(HUSB238_SRC_PDO);
+	husb238_queue_selectPD(PD_SRC_9V);
+	husb238_queue_read(HUSB238_SRC_PDO, HUSB238_PRIO_NEGOTIATION);
+	husb238_queue_service(0);
+
+	uint8_t value = 0;
+	if(!husb238_queue_getRegister(HUSB238_SRC_PDO, &value) || value != (PD_SRC_9V << 4))
+	{
+		printf("FAIL: read after write returned 0x%02x, register holds 0x%02x\n",
+			value, sim_getRegister(HUSB238_SRC_PDO));
+		return 1;
+	}
+	return 0;
+}
+
+/// A profile drop that does not fit completely must not leave a lone SRC_PDO write behind
+static int check_drop_all_or_nothing(void)
+{
+	husb238_queue_clear();
+	for(uint8_t i = 0; i < HUSB238_QUEUE_SIZE - 1; i++)
+	{
+		husb238_queue_write(HUSB238_PD_STATUS0, 0, HUSB238_PRIO_SAFETY);
+	}
+	husb238_queue_selectPD(PD_SRC_9V);
+	if(husb238_queue_dropPD() || husb238_queue_pending() != HUSB238_QUEUE_SIZE - 1)
+	{
+		printf("FAIL: partial profile drop queued, %u commands pending\n", husb238_queue_pending());
+		return 1;
+	}
+	if(!husb238_queue_reset() || husb238_queue_pending() != HUSB238_QUEUE_SIZE)
+	{
+		printf("FAIL: reset did not fit into the last slot\n");
+		return 1;
+	}
+	husb238_queue_clear();
+	return 0;
+}
+
+int main(void)
+{
+	sim_reset();
+	sim_setAttached(true);
+	sim_setPDO(PD_SRC_5V, CURRENT_3_0_A);
+	sim_setPDO(PD_SRC_9V, CURRENT_3_0_A);
+	husb238_setTransport(&sim_transport);
+	husb238_queue_init();
+
+	if(check_read_after_write() || check_drop_all_or_nothing())
+	{
+		return 1;
+	}
+
+	sim_setTransactionTime(TRANSACTION_US);
+	sim_setHook(transaction_hook);
+	husb238_queue_clear();
+	husb238_queue_resetStats();
+
+	uint32_t executed = 0;
+	for(uint32_t i = 0; i < ITERATIONS; i++)
+	{
+		for(uint8_t reg = HUSB238_PD_STATUS0; reg <= HUSB238_SRC_PDO; reg++)
+		{
+			husb238_queue_poll(reg);
+		}
+		if(next_random() % 25 == 0)
+		{
+			negotiation_requests++;
+			husb238_queue_selectPD(next_random() % 2 ? PD_SRC_9V : PD_SRC_5V);
+			husb238_queue_requestPD();
+		}
+		executed += husb238_queue_service(1);
+	}
+	executed += husb238_queue_service(0);
+
+	uint32_t safety = husb238_queue_getMaxLatency(HUSB238_PRIO_SAFETY);
+	uint32_t negotiation = husb238_queue_getMaxLatency(HUSB238_PRIO_NEGOTIATION);
+	uint32_t telemetry = husb238_queue_getMaxLatency(HUSB238_PRIO_TELEMETRY);
+	printf("commands executed:    %u (%u safety events, %u profile requests)\n",
+		executed, safety_events, negotiation_requests);
+	printf("reads merged:         %u\n", husb238_queue_getMerged());
+	printf("dropped/flushed:      %u\n", husb238_queue_getDropped());
+	printf("max latency safety:      %6u us\n", safety);
+	printf("max latency negotiation: %6u us\n", negotiation);
+	printf("max latency telemetry:   %6u us\n", telemetry);
+
+	// A safety event queues at most two commands while a transaction is in flight:
+	// the rest of that transaction plus two transactions.
+	uint32_t bound = 3 * TRANSACTION_US;
+	if(safety_events == 0 || safety > bound)
+	{
+		printf("FAIL: safety latency %u us exceeds bound %u us\n", safety, bound);
+		return 1;
+	}
+	printf("safety latency within bound of %u us\n", bound);
+	return 0;
+}
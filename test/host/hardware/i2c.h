@@ -0,0 +1,16 @@
+#ifndef HOST_HARDWARE_I2C_H
+#define HOST_HARDWARE_I2C_H
+
+// Ersatz für hardware/i2c.h: Auf dem Host gibt es keinen Bus, jeder Zugriff
+// schlägt fehl. Tests setzen einen eigenen HUSB238Transport.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct i2c_inst i2c_inst_t;
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
+
+#endif // HOST_HARDWARE_I2C_H
@@ -0,0 +1,45 @@
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+#include "host_pico.h"
+
+static uint64_t virtual_time_us = 0;	///< Virtual clock, only advanced explicitly or by sleep_us()
+
+uint64_t time_us_64(void)
+{
+	return virtual_time_us;
+}
+
+uint32_t time_us_32(void)
+{
+	return (uint32_t)virtual_time_us;
+}
+
+void sleep_us(uint64_t us)
+{
+	virtual_time_us += us;
+}
+
+void sleep_ms(uint32_t ms)
+{
+	virtual_time_us += (uint64_t)ms * 1000;
+}
+
+void host_set_time_us(uint64_t now_us)
+{
+	virtual_time_us = now_us;
+}
+
+void host_advance_us(uint64_t us)
+{
+	virtual_time_us += us;
+}
+
+int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop)
+{
+	return PICO_ERROR_GENERIC;
+}
+
+int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop)
+{
+	return PICO_ERROR_GENERIC;
+}
@@ -0,0 +1,10 @@
+#ifndef HOST_PICO_H
+#define HOST_PICO_H
+
+#include <stdint.h>
+
+// Steuerung der virtuellen Uhr des Host-Builds
+void host_set_time_us(uint64_t now_us);
+void host_advance_us(uint64_t us);
+
+#endif // HOST_PICO_H
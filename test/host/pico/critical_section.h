@@ -0,0 +1,38 @@
+#ifndef HOST_PICO_CRITICAL_SECTION_H
+#define HOST_PICO_CRITICAL_SECTION_H
+
+// Ersatz für pico/critical_section.h: Der Host-Build ist single-threaded, die
+// Funktionen prüfen nur, dass Sperren richtig gepaart sind.
+
+#include <stdbool.h>
+#include <assert.h>
+
+typedef struct {
+	bool initialized;	///< critical_section_init() was called
+	bool locked;		///< Lock is held
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t *crit_sec)
+{
+	crit_sec->initialized = true;
+	crit_sec->locked = false;
+}
+
+static inline bool critical_section_is_initialized(critical_section_t *crit_sec)
+{
+	return crit_sec->initialized;
+}
+
+static inline void critical_section_enter_blocking(critical_section_t *crit_sec)
+{
+	assert(crit_sec->initialized && !crit_sec->locked);
+	crit_sec->locked = true;
+}
+
+static inline void critical_section_exit(critical_section_t *crit_sec)
+{
+	assert(crit_sec->locked);
+	crit_sec->locked = false;
+}
+
+#endif // HOST_PICO_CRITICAL_SECTION_H
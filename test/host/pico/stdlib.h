@@ -0,0 +1,24 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+// Minimaler Ersatz für pico/stdlib.h, damit die Bibliothek auf dem Host läuft.
+// Die Zeit ist eine virtuelle Uhr, siehe host_pico.h.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+#define PICO_ERROR_GENERIC	-1	///< Same value as in the Pico SDK
+
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+static inline void tight_loop_contents(void)
+{
+}
+
+#endif // HOST_PICO_STDLIB_H
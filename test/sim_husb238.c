@@ -0,0 +1,236 @@
+#include "sim_husb238.h"
+#include "host_pico.h"
+
+static uint8_t regs[HUSB238_GO_COMMAND + 1];	///< Register file
+static bool attached = false;					///< Charger attached
+static uint32_t transaction_us = 0;				///< Virtual bus time per transaction
+static uint32_t contract_delay_us = 0;			///< Time from request to new contract
+static uint32_t reject_cnt = 0;					///< Requests still to answer with RESPONSE_INVALID_CMD_OR_ARG
+static uint32_t fail_cnt = 0;					///< Number of transactions that still have to fail
+static void (*transaction_hook)(void) = NULL;	///< Called in the middle of every transaction
+static uint32_t transactions = 0;				///< Number of transactions
+static uint32_t requests = 0;					///< Number of PD requests
+
+static bool contract_pending = false;	///< A request waits for contract_delay_us
+static uint64_t contract_at_us = 0;		///< Time the pending request completes
+static uint8_t contract_src = 0;		///< PD_SRC_* of the pending request
+
+/// PDO register of a PD_SRC_* selection, 0 if invalid
+static uint8_t pdo_register(uint8_t pd_src)
+{
+	switch (pd_src)
+	{
+	case PD_SRC_5V:
+		return HUSB238_SRC_PDO_5V;
+	case PD_SRC_9V:
+		return HUSB238_SRC_PDO_9V;
+	case PD_SRC_12V:
+		return HUSB238_SRC_PDO_12V;
+	case PD_SRC_15V:
+		return HUSB238_SRC_PDO_15V;
+	case PD_SRC_18V:
+		return HUSB238_SRC_PDO_18V;
+	case PD_SRC_20V:
+		return HUSB238_SRC_PDO_20V;
+	default:
+		return 0;
+	}
+}
+
+/// Sets the response code in PD_STATUS1
+static void set_response(uint8_t response)
+{
+	regs[HUSB238_PD_STATUS1] = (regs[HUSB238_PD_STATUS1] & ~0x38) | (response << 3);
+}
+
+/// Sets PD_STATUS0 to the contract of a PDO register (voltage code = register - 1)
+static void set_contract(uint8_t pdo_reg)
+{
+	regs[HUSB238_PD_STATUS0] = ((pdo_reg - 1) << 4) | (regs[pdo_reg] & 0x0F);
+}
+
+/// Completes a pending request once its time has come
+static void update(void)
+{
+	// Attach bit and 5V contract bit: an attached source always provides the default 5V
+	regs[HUSB238_PD_STATUS1] = (regs[HUSB238_PD_STATUS1] & ~0x44) | (attached ? 0x44 : 0);
+	if(contract_pending && time_us_64() >= contract_at_us)
+	{
+		contract_pending = false;
+		uint8_t pdo_reg = pdo_register(contract_src);
+		if(!attached || reject_cnt > 0 || pdo_reg == 0 || !(regs[pdo_reg] & 0x80))
+		{
+			if(reject_cnt > 0)
+			{
+				reject_cnt--;
+			}
+			set_response(RESPONSE_INVALID_CMD_OR_ARG);
+		}
+		else
+		{
+			set_contract(pdo_reg);
+			set_response(RESPONE_SUCCESS);
+		}
+	}
+}
+
+/// Spends the bus time of one transaction and returns false if it has to fail
+static bool transaction(void)
+{
+	transactions++;
+	host_advance_us(transaction_us / 2);
+	if(transaction_hook != NULL)
+	{
+		transaction_hook();
+	}
+	host_advance_us(transaction_us - transaction_us / 2);
+	update();
+	if(fail_cnt > 0)
+	{
+		fail_cnt--;
+		return false;
+	}
+	return true;
+}
+
+static bool sim_write(uint8_t reg, uint8_t value, void *ctx)
+{
+	if(!transaction())
+	{
+		return false;
+	}
+	if(reg > HUSB238_GO_COMMAND)
+	{
+		return false;
+	}
+	if(reg == HUSB238_GO_COMMAND)
+	{
+		if((value & 0x1F) == 0b00001)
+		{
+			// The response of the previous request stays until this one completes
+			requests++;
+			contract_pending = true;
+			contract_at_us = time_us_64() + contract_delay_us;
+			contract_src = regs[HUSB238_SRC_PDO] >> 4;
+			update();
+		}
+		else if((value & 0x1F) == 0b10000 && attached)
+		{
+			contract_pending = false;
+			regs[HUSB238_SRC_PDO] = 0;
+			set_contract(HUSB238_SRC_PDO_5V);
+		}
+		return true;
+	}
+	regs[reg] = value;
+	return true;
+}
+
+static bool sim_read(uint8_t reg, uint8_t *value, uint8_t len, void *ctx)
+{
+	if(!transaction())
+	{
+		return false;
+	}
+	for(uint8_t i = 0; i < len; i++)
+	{
+		value[i] = (reg + i <= HUSB238_GO_COMMAND) ? regs[reg + i] : 0;
+	}
+	return true;
+}
+
+const HUSB238Transport sim_transport = {sim_write, sim_read, NULL};
+
+void sim_reset(void)
+{
+	for(uint8_t i = 0; i <= HUSB238_GO_COMMAND; i++)
+	{
+		regs[i] = 0;
+	}
+	attached = false;
+	transaction_us = 0;
+	contract_delay_us = 0;
+	reject_cnt = 0;
+	fail_cnt = 0;
+	transaction_hook = NULL;
+	transactions = 0;
+	requests = 0;
+	contract_pending = false;
+}
+
+/// Attaching starts with the default 5V contract, detaching drops everything
+void sim_setAttached(bool new_attached)
+{
+	attached = new_attached;
+	contract_pending = false;
+	if(attached)
+	{
+		set_contract(HUSB238_SRC_PDO_5V);
+		set_response(RESPONE_SUCCESS);
+	}
+	else
+	{
+		regs[HUSB238_PD_STATUS0] = 0;
+		set_response(NO_RESPONSE);
+	}
+	update();
+}
+
+void sim_setPDO(uint8_t pd_src, uint8_t current)
+{
+	uint8_t pdo_reg = pdo_register(pd_src);
+	if(pdo_reg != 0)
+	{
+		regs[pdo_reg] = 0x80 | (current & 0x0F);
+	}
+}
+
+void sim_setTransactionTime(uint32_t us)
+{
+	transaction_us = us;
+}
+
+void sim_setContractDelay(uint32_t us)
+{
+	contract_delay_us = us;
+}
+
+void sim_rejectRequests(uint32_t count)
+{
+	reject_cnt = count;
+}
+
+/// Changes the contract without a request, like a charger that falls back to 5V
+void sim_setContract(uint8_t pd_src)
+{
+	uint8_t pdo_reg = pdo_register(pd_src);
+	if(attached && pdo_reg != 0)
+	{
+		set_contract(pdo_reg);
+	}
+}
+
+void sim_failNext(uint32_t new_fail_cnt)
+{
+	fail_cnt = new_fail_cnt;
+}
+
+void sim_setHook(void (*hook)(void))
+{
+	transaction_hook = hook;
+}
+
+uint8_t sim_getRegister(uint8_t reg)
+{
+	return reg <= HUSB238_GO_COMMAND ? regs[reg] : 0;
+}
+
+uint32_t sim_getTransactions(void)
+{
+	return transactions;
+}
+
+uint32_t sim_getRequests(void)
+{
+	return requests;
+}
@@ -0,0 +1,24 @@
+#ifndef SIM_HUSB238_H
+#define SIM_HUSB238_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "husb238.h"
+
+// Simulierter HUSB238 für die Host-Tests. Jede Transaktion kostet virtuelle Zeit.
+extern const HUSB238Transport sim_transport;
+
+void sim_reset(void);
+void sim_setAttached(bool attached);
+void sim_setPDO(uint8_t pd_src, uint8_t current);
+void sim_setTransactionTime(uint32_t us);
+void sim_setContractDelay(uint32_t us);
+void sim_rejectRequests(uint32_t count);
+void sim_setContract(uint8_t pd_src);
+void sim_failNext(uint32_t transactions);
+void sim_setHook(void (*hook)(void));
+uint8_t sim_getRegister(uint8_t reg);
+uint32_t sim_getTransactions(void);
+uint32_t sim_getRequests(void);
+
+#endif // SIM_HUSB238_H
@@ -0,0 +1,255 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "husb238_budget.h"
+#include "sim_husb238.h"
+
+// Tests des Power-Budget-Orchestrators: Optimum, gestaffelte Umschaltung,
+// inkrementelles Neuberechnen gegen eine vollständige Berechnung, ein Sink am
+// simulierten HUSB238 und der Wechsel der PDO-Tabelle.
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); return 1; } } while(0)
+
+static const PDProfile profiles_a[3] = {	// 15 W, 27 W, 60 W
+	{PD_SRC_5V, 3000, 15}, {PD_SRC_9V, 3000, 27}, {PD_SRC_20V, 3000, 60}
+};
+static const PDProfile profiles_b[4] = {	// 10 W, 21 W, 36 W, 45 W
+	{PD_SRC_5V, 2000, 10}, {PD_SRC_9V, 2250, 21}, {PD_SRC_12V, 3000, 36}, {PD_SRC_15V, 3000, 45}
+};
+
+static uint16_t budget_w = 0;		///< Budget of the current test
+static uint8_t order[8];			///< Sinks in the order they were renegotiated
+static uint8_t order_cnt = 0;		///< Number of renegotiations
+static bool overcommitted = false;	///< Active power exceeded the budget during a step
+
+static bool sim_sink = false;		///< Sink 0 is the simulated HUSB238
+
+static bool renegotiate(uint8_t sink, uint8_t pd_src, void *ctx)
+{
+	if(order_cnt < sizeof(order))
+	{
+		order[order_cnt] = sink;
+	}
+	order_cnt++;
+	if(husb238_budget_getActivePower() > budget_w)
+	{
+		overcommitted = true;
+	}
+	if(sim_sink && sink == 0 && pd_src != PD_NOT_SELECTED)
+	{
+		husb2238_selectPD(pd_src);
+		husb238_requestPD();
+		return husb238_getPDRespone() == RESPONE_SUCCESS && husb238_getPDSrcVoltage() == pd_src;
+	}
+	return true;
+}
+
+static void setup(uint16_t total_w)
+{
+	budget_w = total_w;
+	order_cnt = 0;
+	overcommitted = false;
+	sim_sink = false;
+	husb238_budget_init(total_w, 1000, renegotiate, NULL);
+}
+
+/// Applies the assignment, one step per millisecond
+static void apply(void)
+{
+	uint32_t now_us = 0;
+	for(int i = 0; i < 100 && husb238_budget_step(now_us) > 0; i++)
+	{
+		now_us += 1000;
+		if(husb238_budget_getActivePower() > budget_w)
+		{
+			overcommitted = true;
+		}
+	}
+}
+
+static int test_two_sinks(void)
+{
+	setup(100);
+	int8_t s0 = husb238_budget_addSink(profiles_a, 3, 60);
+	int8_t s1 = husb238_budget_addSink(profiles_a, 3, 60);
+	CHECK(s0 == 0 && s1 == 1);
+	CHECK(husb238_budget_solve() == 87);
+	CHECK(husb238_budget_getAssigned(0) != husb238_budget_getAssigned(1));
+	apply();
+	CHECK(order_cnt == 2 && !overcommitted);
+	CHECK(husb238_budget_getActivePower() == 87);
+
+	// Swap the demands: the 60 W sink has to drop before the other one may rise
+	uint8_t big = husb238_budget_getActive(0) == PD_SRC_20V ? 0 : 1;
+	husb238_budget_setDemand(big, 27);
+	husb238_budget_setDemand(1 - big, 60);
+	order_cnt = 0;
+	CHECK(husb238_budget_solve() == 87);
+	CHECK(husb238_budget_getAssigned(big) == PD_SRC_9V);
+	CHECK(husb238_budget_getAssigned(1 - big) == PD_SRC_20V);
+	apply();
+	CHECK(order_cnt == 2 && order[0] == big && order[1] == 1 - big && !overcommitted);
+
+	// Nothing changed: no renegotiation at all
+	order_cnt = 0;
+	husb238_budget_solve();
+	apply();
+	CHECK(order_cnt == 0);
+	return 0;
+}
+
+static int test_shed(void)
+{
+	setup(20);
+	husb238_budget_addSink(profiles_a, 3, 15);
+	husb238_budget_addSink(profiles_a, 3, 15);
+	CHECK(husb238_budget_solve() == 15);
+	CHECK((husb238_budget_getAssigned(0) == PD_NOT_SELECTED) != (husb238_budget_getAssigned(1) == PD_NOT_SELECTED));
+	return 0;
+}
+
+/// Sink 0 is a HUSB238 on the simulator: its table comes from the PDO registers and
+/// the callback negotiates through SRC_PDO and GO_COMMAND
+static int test_simulated_sink(void)
+{
+	sim_reset();
+	sim_setAttached(true);
+	sim_setPDO(PD_SRC_5V, CURRENT_3_0_A);
+	sim_setPDO(PD_SRC_9V, CURRENT_3_0_A);
+	sim_setPDO(PD_SRC_20V, CURRENT_3_0_A);
+	husb238_setTransport(&sim_transport);
+
+	setup(100);
+	sim_sink = true;
+	uint8_t cnt = husb238_getSupportedVoltages();
+	CHECK(cnt == 3);
+	int8_t s0 = husb238_budget_addSink(supported_profiles, cnt, 60);
+	int8_t s1 = husb238_budget_addSink(profiles_a, 3, 60);
+	CHECK(s0 == 0 && s1 == 1);
+	CHECK(husb238_budget_solve() == 87);
+	apply();
+	CHECK(order_cnt == 2 && !overcommitted);
+	CHECK(husb238_budget_getActive(0) == husb238_budget_getAssigned(0));
+	CHECK(husb238_getPDSrcVoltage() == husb238_budget_getActive(0));
+	CHECK(sim_getRequests() == 1);
+
+	// A rejected request leaves the sink on its old profile until it is accepted
+	husb238_budget_setDemand(0, husb238_budget_getActive(0) == PD_SRC_20V ? 27 : 60);
+	husb238_budget_setDemand(1, husb238_budget_getActive(0) == PD_SRC_20V ? 60 : 27);
+	uint8_t before = husb238_budget_getActive(0);
+	husb238_budget_solve();
+	sim_rejectRequests(1);
+	order_cnt = 0;
+	apply();
+	CHECK(!overcommitted && order_cnt == 3);
+	CHECK(husb238_budget_getActive(0) != before);
+	CHECK(husb238_getPDSrcVoltage() == husb238_budget_getActive(0));
+	CHECK(husb238_budget_getActivePower() == 87);
+	return 0;
+}
+
+/// A new PDO table without the active profile releases its power and stops the callback
+static int test_table_change(void)
+{
+	setup(100);
+	husb238_budget_addSink(profiles_a, 3, 60);
+	husb238_budget_solve();
+	apply();
+	CHECK(husb238_budget_getActive(0) == PD_SRC_20V && husb238_budget_getActivePower() == 60);
+
+	husb238_budget_setProfiles(0, profiles_b, 4);
+	CHECK(husb238_budget_getActive(0) == PD_NOT_SELECTED);
+	CHECK(husb238_budget_getActivePower() == 0);
+	order_cnt = 0;
+	apply();
+	CHECK(order_cnt == 0);
+
+	CHECK(husb238_budget_solve() == 45);
+	apply();
+	CHECK(order_cnt == 1 && husb238_budget_getActive(0) == PD_SRC_15V);
+	CHECK(husb238_budget_getActivePower() == 45);
+	return 0;
+}
+
+/// Exhaustive search over all assignments of a small instance
+static uint16_t brute_force(const uint8_t *kind, const uint16_t *demand, uint8_t n, uint16_t total_w)
+{
+	uint16_t best = 0;
+	uint32_t combos = 1;
+	for(uint8_t i = 0; i < n; i++)
+	{
+		combos *= 5;
+	}
+	for(uint32_t c = 0; c < combos; c++)
+	{
+		uint32_t rest = c;
+		uint16_t used = 0;
+		uint16_t delivered = 0;
+		bool valid = true;
+		for(uint8_t i = 0; i < n; i++)
+		{
+			uint8_t opt = rest % 5;
+			rest /= 5;
+			if(opt == 0)
+			{
+				continue;
+			}
+			const PDProfile *p = kind[i] ? profiles_b : profiles_a;
+			uint8_t cnt = kind[i] ? 4 : 3;
+			if(opt > cnt)
+			{
+				valid = false;
+				break;
+			}
+			uint16_t w = p[opt - 1].power;
+			used += w;
+			delivered += w < demand[i] ? w : demand[i];
+		}
+		if(valid && used <= total_w && delivered > best)
+		{
+			best = delivered;
+		}
+	}
+	return best;
+}
+
+static int test_random(void)
+{
+	srand(1);
+	for(int round = 0; round < 300; round++)
+	{
+		uint8_t n = 1 + rand() % 6;
+		uint16_t total_w = 10 + rand() % 150;
+		uint8_t kind[6];
+		uint16_t demand[6];
+
+		setup(total_w);
+		for(uint8_t i = 0; i < n; i++)
+		{
+			kind[i] = rand() % 2;
+			demand[i] = rand() % 70;
+			husb238_budget_addSink(kind[i] ? profiles_b : profiles_a, kind[i] ? 4 : 3, demand[i]);
+		}
+		CHECK(husb238_budget_solve() == brute_force(kind, demand, n, total_w));
+		apply();
+		CHECK(!overcommitted && husb238_budget_getActivePower() <= total_w);
+
+		// Incremental re-solve after one demand change
+		uint8_t sink = rand() % n;
+		demand[sink] = rand() % 70;
+		husb238_budget_setDemand(sink, demand[sink]);
+		CHECK(husb238_budget_solve() == brute_force(kind, demand, n, total_w));
+		apply();
+		CHECK(!overcommitted && husb238_budget_getActivePower() <= total_w);
+	}
+	return 0;
+}
+
+int main(void)
+{
+	if(test_two_sinks() || test_shed() || test_simulated_sink() || test_table_change() || test_random())
+	{
+		return 1;
+	}
+	printf("budget tests passed\n");
+	return 0;
+}
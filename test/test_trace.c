@@ -0,0 +1,146 @@
+#include <stdio.h>
+#include <string.h>
+#include "husb238_trace.h"
+#include "sim_husb238.h"
+#include "host_pico.h"
+
+// Wiedergabe eines aufgezeichneten Bus-Traces als Regressionstest.
+//
+//   test_trace <capture>           Replays the capture and checks the driver against it
+//   test_trace --record <capture>  Records a new capture against the simulator
+//
+// The checked-in capture test/captures/init_9v.bin was recorded against the simulator:
+// husb238_init(), a request for 9V and status polls until the 9V contract is reported.
+
+#define MAX_RECORDS			256
+#define EXPECTED_TRANSACTIONS	8	///< Bus transactions of the scenario; update on purpose only
+#define TRANSACTION_US		270		///< Simulated bus time per transaction
+#define CONTRACT_DELAY_US	1000	///< Simulated time from request to contract
+
+#define CHECK(cond) do { if(!(cond)) { printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); return 1; } } while(0)
+
+static HUSB238TraceRecord trace[MAX_RECORDS];	///< Capture buffer
+
+/// The driver sequence the capture was taken from
+static int8_t scenario(void)
+{
+	int8_t profiles = husb238_init(NULL);
+	husb2238_selectPD(PD_SRC_9V);
+	husb238_requestPD();
+	for(uint8_t i = 0; i < 20 && husb238_getPDSrcVoltage() != PD_SRC_9V; i++)
+	{
+		sleep_us(250);
+	}
+	return profiles;
+}
+
+static int record(const char *path)
+{
+	sim_reset();
+	sim_setPDO(PD_SRC_5V, CURRENT_3_0_A);
+	sim_setPDO(PD_SRC_9V, CURRENT_3_0_A);
+	sim_setPDO(PD_SRC_20V, CURRENT_2_25_A);
+	sim_setAttached(true);
+	sim_setTransactionTime(TRANSACTION_US);
+	sim_setContractDelay(CONTRACT_DELAY_US);
+	husb238_setTransport(&sim_transport);
+
+	husb238_trace_startRecording(trace, MAX_RECORDS);
+	scenario();
+	uint32_t cnt = husb238_trace_stopRecording();
+
+	FILE *f = fopen(path, "wb");
+	CHECK(f != NULL && !husb238_trace_isOverflowed());
+	CHECK(fwrite(trace, sizeof(HUSB238TraceRecord), cnt, f) == cnt);
+	fclose(f);
+	printf("recorded %u records, %u transactions\n", cnt, husb238_trace_getTransactions());
+	return 0;
+}
+
+static int replay(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	CHECK(f != NULL);
+	uint32_t cnt = fread(trace, sizeof(HUSB238TraceRecord), MAX_RECORDS, f);
+	fclose(f);
+	CHECK(cnt > 0);
+	uint32_t duration_us = trace[cnt - 1].timestamp_us;
+
+	// As fast as possible: same traffic, same result, no time spent
+	host_set_time_us(0);
+	husb238_trace_startReplay(trace, cnt, HUSB238_TRACE_NO_WAIT);
+	int8_t profiles = scenario();
+	uint64_t elapsed_us = time_us_64();
+	CHECK(husb238_trace_stopReplay() == cnt);
+	CHECK(husb238_trace_getDivergence() == HUSB238_TRACE_NO_DIVERGENCE);
+	CHECK(profiles == 3);
+	printf("replayed %u records: %u transactions (expected %u), %u us recorded\n",
+		cnt, husb238_trace_getTransactions(), EXPECTED_TRANSACTIONS, duration_us);
+	CHECK(husb238_trace_getTransactions() == EXPECTED_TRANSACTIONS);
+
+	// The driver's own sleeps are the only time that passes without waiting
+	uint64_t sleeps_us = elapsed_us;
+
+	// Real time: the replay ends exactly at the recorded time of the last record
+	host_set_time_us(0);
+	husb238_trace_startReplay(trace, cnt, HUSB238_TRACE_REALTIME);
+	scenario();
+	husb238_trace_stopReplay();
+	CHECK(husb238_trace_getDivergence() == HUSB238_TRACE_NO_DIVERGENCE);
+	CHECK(time_us_64() >= duration_us && time_us_64() <= duration_us + sleeps_us);
+
+	// A driver that requests another profile leaves the trace at that write
+	host_set_time_us(0);
+	husb238_trace_startReplay(trace, cnt, HUSB238_TRACE_NO_WAIT);
+	husb238_init(NULL);
+	husb2238_selectPD(PD_SRC_20V);
+	husb238_trace_stopReplay();
+	uint32_t divergence = husb238_trace_getDivergence();
+	CHECK(divergence < cnt && (trace[divergence].flags & HUSB238_TRACE_WRITE) &&
+		trace[divergence].reg == HUSB238_SRC_PDO);
+	return 0;
+}
+
+/// Starting a recording or replay while it is running restarts it instead of wrapping itself
+static int restart(void)
+{
+	static HUSB238TraceRecord first[4];
+	sim_reset();
+	sim_setAttached(true);
+	husb238_setTransport(&sim_transport);
+
+	husb238_trace_startRecording(first, 4);
+	husb238_isAttached();
+	husb238_trace_startRecording(trace, MAX_RECORDS);
+	CHECK(husb238_isAttached());
+	CHECK(husb238_trace_stopRecording() == 1);
+	CHECK(husb238_trace_getTransactions() == 1);
+	CHECK(husb238_getTransport() == &sim_transport);
+
+	husb238_trace_startReplay(first, 1, HUSB238_TRACE_NO_WAIT);
+	husb238_trace_startReplay(trace, 1, HUSB238_TRACE_NO_WAIT);
+	CHECK(husb238_isAttached());
+	CHECK(husb238_trace_stopReplay() == 1);
+	CHECK(husb238_trace_getDivergence() == HUSB238_TRACE_NO_DIVERGENCE);
+	CHECK(husb238_getTransport() == &sim_transport);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc == 3 && strcmp(argv[1], "--record") == 0)
+	{
+		return record(argv[2]);
+	}
+	if(argc != 2)
+	{
+		printf("usage: %s [--record] <capture>\n", argv[0]);
+		return 2;
+	}
+	if(restart() || replay(argv[1]))
+	{
+		return 1;
+	}
+	printf("trace replay passed\n");
+	return 0;
+}